@@ -1,10 +0,0 @@
-#version 330 core
-out vec4 f_color;
-
-in vec2 uv;
-in vec4 color;
-
-void main()
-{
-    f_color = color;
-}
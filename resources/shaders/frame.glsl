@@ -0,0 +1,7 @@
+// Per-frame constants shared by every program through one uniform buffer.
+// Must match Frame_Uniforms.
+layout(std140) uniform Frame {
+    mat4 view;
+    vec2 resolution;  // of the framebuffer, in pixels
+    float time;       // in seconds, stops while paused
+};
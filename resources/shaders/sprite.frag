@@ -0,0 +1,28 @@
+#version 330 core
+// Variants: WIREFRAME draws a pulsing flat color, TEXTURE samples the quad's
+// texture slot, TEXTURE_ARRAY a layer of the array texture, and without
+// any of them the vertex color is used as is.
+out vec4 f_color;
+
+#define VARYING in
+#include "varyings.glsl"
+#include "frame.glsl"
+
+#if defined(TEXTURE)
+#include "texture_slots.glsl"
+#elif defined(TEXTURE_ARRAY)
+uniform sampler2DArray textures;
+#endif
+
+void main()
+{
+#if defined(WIREFRAME)
+    f_color = vec4(0.5f + 0.25f * sin(time * 4.0f), 0.2f, 0.2f, 1.0f);
+#elif defined(TEXTURE)
+    f_color = sample_slot(slot, uv);
+#elif defined(TEXTURE_ARRAY)
+    f_color = texture(textures, vec3(uv, layer));
+#else
+    f_color = color;
+#endif
+}
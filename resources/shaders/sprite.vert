@@ -0,0 +1,52 @@
+#version 330 core
+// Variants: INSTANCED expands one Quad_Instance into a quad, otherwise
+// every vertex comes from the batch.
+
+#ifdef INSTANCED
+layout(location = 0) in vec2 i_center;
+layout(location = 1) in vec2 i_half_size;
+layout(location = 2) in vec4 i_color;
+layout(location = 3) in vec4 i_uv_rect;
+layout(location = 4) in float i_rotation;
+layout(location = 5) in float i_slot;
+layout(location = 6) in float i_layer;
+#else
+layout(location = 0) in vec2 v_pos;
+layout(location = 1) in vec2 v_uv;
+layout(location = 2) in vec4 v_color;
+layout(location = 3) in float v_slot;
+layout(location = 4) in float v_layer;
+
+// Quantized vertex formats store positions relative to this scale.
+uniform float position_scale;
+#endif
+
+#include "frame.glsl"
+
+#define VARYING out
+#include "varyings.glsl"
+
+void main()
+{
+#ifdef INSTANCED
+    // Unit quad drawn as a 4 vertex triangle strip: (0,0) (1,0) (0,1) (1,1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 offset = (corner * 2.0 - 1.0) * i_half_size;
+
+    float s = sin(i_rotation);
+    float c = cos(i_rotation);
+    offset = vec2(c * offset.x - s * offset.y, s * offset.x + c * offset.y);
+
+    gl_Position = view * vec4(i_center + offset, 0.0, 1.0);
+    color = i_color;
+    uv = mix(i_uv_rect.xy, i_uv_rect.zw, corner);
+    slot = int(i_slot);
+    layer = int(i_layer);
+#else
+    gl_Position = view * vec4(v_pos * position_scale, 0.0, 1.0);
+    color = v_color;
+    uv = v_uv;
+    slot = int(v_slot);
+    layer = int(v_layer);
+#endif
+}
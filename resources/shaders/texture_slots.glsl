@@ -0,0 +1,26 @@
+// Must match R_TEXTURE_SLOTS. Sampler arrays can only be indexed with
+// constant expressions in GLSL 3.30, hence the switch.
+uniform sampler2D textures[16];
+
+vec4 sample_slot(int slot, vec2 uv)
+{
+    switch(slot) {
+        case 0: return texture(textures[0], uv);
+        case 1: return texture(textures[1], uv);
+        case 2: return texture(textures[2], uv);
+        case 3: return texture(textures[3], uv);
+        case 4: return texture(textures[4], uv);
+        case 5: return texture(textures[5], uv);
+        case 6: return texture(textures[6], uv);
+        case 7: return texture(textures[7], uv);
+        case 8: return texture(textures[8], uv);
+        case 9: return texture(textures[9], uv);
+        case 10: return texture(textures[10], uv);
+        case 11: return texture(textures[11], uv);
+        case 12: return texture(textures[12], uv);
+        case 13: return texture(textures[13], uv);
+        case 14: return texture(textures[14], uv);
+        case 15: return texture(textures[15], uv);
+        default: return texture(textures[0], uv);
+    }
+}
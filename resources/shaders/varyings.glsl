@@ -0,0 +1,6 @@
+// Interface between sprite.vert and sprite.frag. Define VARYING as `out`
+// in the vertex and as `in` in the fragment shader before including it.
+VARYING vec2 uv;
+VARYING vec4 color;
+flat VARYING int slot;
+flat VARYING int layer;
@@ -0,0 +1,324 @@
+#include "atlas.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stb_image.h"
+
+#include "dynamic_array.h"
+#include "gl_state.h"
+#include "logger.h"
+#include "texture_memory.h"
+
+#define ATLAS_CHANNELS 4
+
+static int align_up(int x, int alignment)
+{
+    if(alignment <= 1) return x;
+    return (x + alignment - 1) / alignment * alignment;
+}
+
+static void atlas_page_create(Atlas *atlas)
+{
+    Atlas_Page page = {0};
+    page.pixels = calloc((size_t) atlas->page_size * atlas->page_size, ATLAS_CHANNELS);
+    assert(page.pixels != NULL && "Buy more RAM lol");
+
+    da_append(&page.skyline, ((Atlas_Skyline_Node){0, 0, atlas->page_size}));
+    da_append(&atlas->pages, page);
+
+    LOG_TRACE("created atlas page %zu of %dx%d", atlas->pages.count - 1, atlas->page_size, atlas->page_size);
+}
+
+// Height a width x height cell would rest at if its left edge sat on node
+// index, or -1 if it runs off the page.
+static int skyline_fit(const Atlas_Skyline *skyline, int page_size, size_t index, int width, int height)
+{
+    int x = skyline->items[index].x;
+    if(x + width > page_size) return -1;
+
+    int y = 0;
+    int remaining = width;
+    for(size_t i = index; remaining > 0; ++i) {
+        assert(i < skyline->count);
+        if(skyline->items[i].y > y) y = skyline->items[i].y;
+        remaining -= skyline->items[i].width;
+    }
+
+    if(y + height > page_size) return -1;
+    return y;
+}
+
+// Finds the bottom-most (then narrowest-fitting) spot for the cell.
+static bool skyline_find(const Atlas_Skyline *skyline, int page_size, int width, int height,
+                         size_t *best_index, int *best_y)
+{
+    int best_top = page_size + 1;
+    int best_width = page_size + 1;
+    bool found = false;
+
+    for(size_t i = 0; i < skyline->count; ++i) {
+        int y = skyline_fit(skyline, page_size, i, width, height);
+        if(y < 0) continue;
+
+        int top = y + height;
+        if(top < best_top || (top == best_top && skyline->items[i].width < best_width)) {
+            best_top = top;
+            best_width = skyline->items[i].width;
+            *best_index = i;
+            *best_y = y;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+static void skyline_place(Atlas_Skyline *skyline, size_t index, int y, int width, int height)
+{
+    Atlas_Skyline_Node node = {skyline->items[index].x, y + height, width};
+
+    // Make room for the new node in front of index.
+    da_append(skyline, node);
+    memmove(skyline->items + index + 1, skyline->items + index,
+            (skyline->count - 1 - index) * sizeof(*skyline->items));
+    skyline->items[index] = node;
+
+    // Trim or drop the nodes the new one now covers.
+    int right = node.x + node.width;
+    size_t i = index + 1;
+    while(i < skyline->count && skyline->items[i].x < right) {
+        Atlas_Skyline_Node *next = &skyline->items[i];
+        int next_right = next->x + next->width;
+        if(next_right <= right) {
+            memmove(next, next + 1, (skyline->count - i - 1) * sizeof(*skyline->items));
+            skyline->count -= 1;
+        } else {
+            next->width = next_right - right;
+            next->x = right;
+            break;
+        }
+    }
+
+    // Merge neighbours of the same height.
+    for(size_t j = 0; j + 1 < skyline->count;) {
+        Atlas_Skyline_Node *a = &skyline->items[j];
+        Atlas_Skyline_Node *b = &skyline->items[j + 1];
+        if(a->y == b->y) {
+            a->width += b->width;
+            memmove(b, b + 1, (skyline->count - j - 2) * sizeof(*skyline->items));
+            skyline->count -= 1;
+        } else {
+            j += 1;
+        }
+    }
+}
+
+// Copies the image into the cell at (x, y), extruding its edge texels over
+// the rest of the cell.
+static void atlas_blit(Atlas *atlas, Atlas_Page *page, const unsigned char *rgba,
+                       int width, int height, int x, int y, int cell_width, int cell_height)
+{
+    int padding = atlas->padding;
+    for(int cy = 0; cy < cell_height; ++cy) {
+        int sy = cy - padding;
+        if(sy < 0) sy = 0;
+        if(sy >= height) sy = height - 1;
+
+        unsigned char *dst = page->pixels + ((size_t) (y + cy) * atlas->page_size + x) * ATLAS_CHANNELS;
+        const unsigned char *src = rgba + (size_t) sy * width * ATLAS_CHANNELS;
+
+        for(int cx = 0; cx < cell_width; ++cx) {
+            int sx = cx - padding;
+            if(sx < 0) sx = 0;
+            if(sx >= width) sx = width - 1;
+            memcpy(dst + cx * ATLAS_CHANNELS, src + sx * ATLAS_CHANNELS, ATLAS_CHANNELS);
+        }
+    }
+    page->dirty = true;
+}
+
+void atlas_init(Atlas *atlas, int page_size, int padding)
+{
+    assert(page_size > 0);
+    assert(padding >= 0 && (padding & (padding - 1)) == 0 && "padding must be 0 or a power of two");
+
+    *atlas = (Atlas){0};
+    atlas->page_size = page_size;
+    atlas->padding = padding;
+}
+
+void atlas_deallocate(Atlas *atlas)
+{
+    for(size_t i = 0; i < atlas->pages.count; ++i) {
+        Atlas_Page *page = &atlas->pages.items[i];
+        if(page->texture) gls_delete_textures(1, &page->texture);
+        free(page->pixels);
+        free(page->skyline.items);
+    }
+    free(atlas->pages.items);
+    free(atlas->entries.items);
+
+    atlas->pages = (Atlas_Pages){0};
+    atlas->entries = (Atlas_Entries){0};
+}
+
+// Finds a cell for the image, copies it in and fills in where it went.
+static bool atlas_pack(Atlas *atlas, const unsigned char *rgba, int width, int height, Atlas_Entry *entry)
+{
+    int cell_width = align_up(width + 2 * atlas->padding, atlas->padding);
+    int cell_height = align_up(height + 2 * atlas->padding, atlas->padding);
+
+    if(width <= 0 || height <= 0 || cell_width > atlas->page_size || cell_height > atlas->page_size) {
+        LOG_ERROR("image of %dx%d doesn't fit into a %dx%d atlas page",
+                  width, height, atlas->page_size, atlas->page_size);
+        return false;
+    }
+
+    size_t index = 0;
+    int y = 0;
+    size_t page = 0;
+    for(; page < atlas->pages.count; ++page) {
+        if(skyline_find(&atlas->pages.items[page].skyline, atlas->page_size,
+                        cell_width, cell_height, &index, &y)) break;
+    }
+
+    if(page == atlas->pages.count) {
+        atlas_page_create(atlas);
+        bool found = skyline_find(&atlas->pages.items[page].skyline, atlas->page_size,
+                                  cell_width, cell_height, &index, &y);
+        assert(found);
+        (void) found;
+    }
+
+    Atlas_Page *p = &atlas->pages.items[page];
+    int x = p->skyline.items[index].x;
+    skyline_place(&p->skyline, index, y, cell_width, cell_height);
+    atlas_blit(atlas, p, rgba, width, height, x, y, cell_width, cell_height);
+
+    *entry = (Atlas_Entry) {
+        .status = TEXTURE_READY,
+        .page = page,
+        .x = x + atlas->padding,
+        .y = y + atlas->padding,
+        .width = width,
+        .height = height,
+    };
+    return true;
+}
+
+bool atlas_add(Atlas *atlas, const unsigned char *rgba, int width, int height, Atlas_Image *image)
+{
+    Atlas_Entry entry;
+    if(!atlas_pack(atlas, rgba, width, height, &entry)) return false;
+
+    da_append(&atlas->entries, entry);
+    *image = atlas->entries.count - 1;
+    return true;
+}
+
+bool atlas_add_file(Atlas *atlas, const char *file_path, Atlas_Image *image)
+{
+    int width, height;
+    unsigned char *rgba = stbi_load(file_path, &width, &height, NULL, ATLAS_CHANNELS);
+    if(rgba == NULL) {
+        LOG_ERROR("failed to load image %s: %s", file_path, stbi_failure_reason());
+        return false;
+    }
+
+    bool ok = atlas_add(atlas, rgba, width, height, image);
+    stbi_image_free(rgba);
+    return ok;
+}
+
+static void atlas_image_decoded(void *context, size_t id, Texture_Image *image)
+{
+    Atlas *atlas = context;
+    Atlas_Entry *entry = &atlas->entries.items[id];
+
+    if(image == NULL || !atlas_pack(atlas, image->pixels, image->width, image->height, entry)) {
+        entry->status = TEXTURE_FAILED;
+    }
+}
+
+Atlas_Image atlas_add_file_async(Atlas *atlas, Texture_Loader *loader, const char *file_path)
+{
+    da_append(&atlas->entries, ((Atlas_Entry){.status = TEXTURE_PENDING}));
+    Atlas_Image image = atlas->entries.count - 1;
+
+    // Pages are RGBA8 and only mipmapped as deep as the padding allows, so
+    // only the base level is needed, as is.
+    Texture_Cache_Options options = {
+        .mipmaps = false,
+        .compression = TEXTURE_COMPRESSION_NONE,
+    };
+    texture_loader_decode(loader, file_path, options, atlas_image_decoded, atlas, image);
+    return image;
+}
+
+void atlas_upload(Atlas *atlas)
+{
+    // Deeper levels would average texels across the gutters.
+    int max_level = 0;
+    while((1 << (max_level + 1)) <= atlas->padding) max_level += 1;
+
+    size_t page_bytes = 0;
+    for(int level = 0; level <= max_level; ++level) {
+        size_t size = atlas->page_size >> level;
+        page_bytes += size * size * ATLAS_CHANNELS;
+    }
+
+    for(size_t i = 0; i < atlas->pages.count; ++i) {
+        Atlas_Page *page = &atlas->pages.items[i];
+        if(!page->dirty) continue;
+
+        if(page->texture == 0) {
+            glGenTextures(1, &page->texture);
+            gls_bind_texture(0, GL_TEXTURE_2D, page->texture);
+
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max_level);
+        } else {
+            gls_bind_texture(0, GL_TEXTURE_2D, page->texture);
+        }
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+                     atlas->page_size, atlas->page_size, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, page->pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        texture_memory_track(page->texture, page_bytes);
+
+        page->dirty = false;
+    }
+}
+
+Texture_Status atlas_status(const Atlas *atlas, Atlas_Image image)
+{
+    assert(image < atlas->entries.count);
+    return atlas->entries.items[image].status;
+}
+
+GLuint atlas_texture(const Atlas *atlas, Atlas_Image image)
+{
+    assert(image < atlas->entries.count);
+    assert(atlas->entries.items[image].status == TEXTURE_READY);
+    return atlas->pages.items[atlas->entries.items[image].page].texture;
+}
+
+Atlas_UV_Rect atlas_uv_rect(const Atlas *atlas, Atlas_Image image)
+{
+    assert(image < atlas->entries.count);
+    const Atlas_Entry *entry = &atlas->entries.items[image];
+    float size = (float) atlas->page_size;
+
+    return (Atlas_UV_Rect) {
+        entry->x / size,
+        entry->y / size,
+        (entry->x + entry->width) / size,
+        (entry->y + entry->height) / size,
+    };
+}
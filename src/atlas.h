@@ -0,0 +1,95 @@
+#ifndef ATLAS_H_
+#define ATLAS_H_
+
+#include <GL/glew.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "texture_loader.h"
+
+/**
+ * Texture Atlas
+ *
+ * Packs decoded RGBA8 images into a few large square pages with a skyline
+ * bottom-left packer, so quads textured from different images can share a
+ * texture and a batch.
+ *
+ * Every image is surrounded by a gutter of `padding` pixels filled with its
+ * own edge texels, and every cell starts on a multiple of `padding`. That
+ * keeps mip levels up to log2(padding) free of bleeding between images, so
+ * pages are only mipmapped that far. padding must be 0 or a power of two.
+ *
+ * atlas_add_file_async() decodes on the texture loader's workers instead.
+ * The image is handed out right away as pending and packed once its pixels
+ * arrive in texture_loader_update(), so call atlas_upload() after that. The
+ * atlas has to outlive the loader, or at least every decode it queued.
+ */
+
+typedef struct {
+    int x, y;  // y is the height of the skyline over [x, x + width)
+    int width;
+} Atlas_Skyline_Node;
+
+typedef struct {
+    Atlas_Skyline_Node *items;
+    size_t count;
+    size_t capacity;
+} Atlas_Skyline;
+
+typedef struct {
+    GLuint texture;         // 0 until the page is first uploaded
+    unsigned char *pixels;  // page_size * page_size RGBA8
+    Atlas_Skyline skyline;
+    bool dirty;             // pixels changed since the last upload
+} Atlas_Page;
+
+typedef struct {
+    Atlas_Page *items;
+    size_t count;
+    size_t capacity;
+} Atlas_Pages;
+
+typedef struct {
+    Texture_Status status;  // never TEXTURE_EVICTED
+    size_t page;
+    int x, y;               // of the image itself, inside its gutter
+    int width, height;
+} Atlas_Entry;
+
+typedef struct {
+    Atlas_Entry *items;
+    size_t count;
+    size_t capacity;
+} Atlas_Entries;
+
+typedef struct {
+    int page_size;
+    int padding;
+
+    Atlas_Pages pages;
+    Atlas_Entries entries;
+} Atlas;
+
+typedef size_t Atlas_Image;
+
+typedef struct {
+    float u0, v0, u1, v1;
+} Atlas_UV_Rect;
+
+void atlas_init(Atlas *atlas, int page_size, int padding);
+void atlas_deallocate(Atlas *atlas);
+
+bool atlas_add(Atlas *atlas, const unsigned char *rgba, int width, int height, Atlas_Image *image);
+bool atlas_add_file(Atlas *atlas, const char *file_path, Atlas_Image *image);
+Atlas_Image atlas_add_file_async(Atlas *atlas, Texture_Loader *loader, const char *file_path);
+
+// (Re)uploads the pages that changed since the last call, with their mipmaps.
+void atlas_upload(Atlas *atlas);
+
+// Only ready images have a page to draw from.
+Texture_Status atlas_status(const Atlas *atlas, Atlas_Image image);
+GLuint atlas_texture(const Atlas *atlas, Atlas_Image image);
+Atlas_UV_Rect atlas_uv_rect(const Atlas *atlas, Atlas_Image image);
+
+#endif // ATLAS_H_
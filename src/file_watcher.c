@@ -0,0 +1,93 @@
+#include "file_watcher.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "dynamic_array.h"
+#include "logger.h"
+
+bool file_watcher_init(File_Watcher *w, const char *dir_path)
+{
+    *w = (File_Watcher){.fd = -1};
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0) {
+        LOG_WARN("failed to watch `%s`: %s", dir_path, strerror(errno));
+        return false;
+    }
+
+    if(inotify_add_watch(fd, dir_path, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        LOG_WARN("failed to watch `%s`: %s", dir_path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    w->fd = fd;
+    w->dir_path = strdup(dir_path);
+    assert(w->dir_path != NULL && "Buy more RAM lol");
+    return true;
+}
+
+void file_watcher_deallocate(File_Watcher *w)
+{
+    if(w->fd >= 0) close(w->fd);
+    free(w->dir_path);
+    *w = (File_Watcher){.fd = -1};
+}
+
+static bool paths_contain(const File_Paths *paths, size_t first, const char *path)
+{
+    for(size_t i = first; i < paths->count; ++i) {
+        if(strcmp(paths->items[i], path) == 0) return true;
+    }
+    return false;
+}
+
+bool file_watcher_poll(File_Watcher *w, File_Paths *changed)
+{
+    if(w->fd < 0) return true;
+
+    bool complete = true;
+    size_t first = changed->count;
+
+    // Large enough for a few events with names up to NAME_MAX.
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for(;;) {
+        ssize_t n = read(w->fd, buffer, sizeof(buffer));
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN) LOG_WARN("failed to poll `%s`: %s", w->dir_path, strerror(errno));
+            break;
+        }
+
+        for(char *p = buffer; p < buffer + n; ) {
+            const struct inotify_event *event = (const struct inotify_event *) p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if(event->mask & IN_Q_OVERFLOW) {
+                LOG_WARN("missed changes in `%s`", w->dir_path);
+                complete = false;
+            }
+            if(event->len == 0 || (event->mask & IN_ISDIR)) continue;
+
+            size_t size = strlen(w->dir_path) + 1 + strlen(event->name) + 1;
+            char *path = malloc(size);
+            assert(path != NULL && "Buy more RAM lol");
+            snprintf(path, size, "%s/%s", w->dir_path, event->name);
+
+            if(paths_contain(changed, first, path)) {
+                free(path);
+            } else {
+                da_append(changed, path);
+            }
+        }
+    }
+
+    return complete;
+}
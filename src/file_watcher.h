@@ -0,0 +1,34 @@
+#ifndef FILE_WATCHER_H_
+#define FILE_WATCHER_H_
+
+#include <stdbool.h>
+
+#include "filesystem.h"
+
+/**
+ * Directory Watcher
+ *
+ * Reports files of one directory that were written, or renamed into it,
+ * through a non-blocking inotify descriptor, so it can be polled every
+ * frame for free. Editors that save by writing a temporary file and
+ * renaming it over the original are covered by the rename.
+ *
+ * The kernel queue is bounded. When it overflows, events are lost and the
+ * watcher can't tell which files changed, so the caller has to assume all
+ * of them did.
+ */
+
+typedef struct {
+    int fd;            // -1 when not watching
+    char *dir_path;
+} File_Watcher;
+
+bool file_watcher_init(File_Watcher *w, const char *dir_path);
+void file_watcher_deallocate(File_Watcher *w);
+
+// Appends the paths, dir_path/name, of the files changed since the last
+// poll, each once. Returns false if changes were missed because the queue
+// overflowed; whatever was appended is then incomplete.
+bool file_watcher_poll(File_Watcher *w, File_Paths *changed);
+
+#endif // FILE_WATCHER_H_
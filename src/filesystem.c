@@ -1,9 +1,20 @@
 #include "filesystem.h"
 
+#include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dynamic_array.h"
+
 char *slurp_file(const char *file_path)
 {
     char *buf = NULL;
@@ -46,3 +57,150 @@ defer:
     return NULL;
 }
 
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+bool list_directory(const char *dir_path, File_Paths *paths)
+{
+    DIR *dir = opendir(dir_path);
+    if(dir == NULL) return false;
+
+    size_t first = paths->count;
+    size_t dir_len = strlen(dir_path);
+
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL) {
+        if(entry->d_name[0] == '.') continue;
+
+        size_t size = dir_len + 1 + strlen(entry->d_name) + 1;
+        char *path = malloc(size);
+        assert(path != NULL && "Buy more RAM lol");
+        snprintf(path, size, "%s/%s", dir_path, entry->d_name);
+
+        struct stat st;
+        if(stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        da_append(paths, path);
+    }
+
+    int serr = errno;
+    closedir(dir);
+    errno = serr;
+
+    if(paths->count > first) {
+        qsort(paths->items + first, paths->count - first, sizeof(*paths->items), compare_paths);
+    }
+    return true;
+}
+
+void file_paths_free(File_Paths *paths)
+{
+    for(size_t i = 0; i < paths->count; ++i) free(paths->items[i]);
+    free(paths->items);
+    *paths = (File_Paths){0};
+}
+
+bool map_file(const char *file_path, File_Mapping *mapping)
+{
+    *mapping = (File_Mapping){0};
+
+    int fd = open(file_path, O_RDONLY);
+    if(fd < 0) return false;
+
+    bool result = true;
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        result = false;
+    } else if(st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED) {
+            result = false;
+        } else {
+            mapping->data = data;
+            mapping->size = st.st_size;
+        }
+    }
+
+    int serr = errno;
+    close(fd);
+    errno = serr;
+    return result;
+}
+
+void unmap_file(File_Mapping *mapping)
+{
+    if(mapping->data) munmap(mapping->data, mapping->size);
+    *mapping = (File_Mapping){0};
+}
+
+bool make_directories(const char *dir_path)
+{
+    if(*dir_path == '\0') return true;
+
+    char *path = strdup(dir_path);
+    assert(path != NULL && "Buy more RAM lol");
+
+    bool result = true;
+    for(char *p = path + 1; ; ++p) {
+        if(*p != '/' && *p != '\0') continue;
+
+        char c = *p;
+        *p = '\0';
+        if(mkdir(path, 0755) < 0 && errno != EEXIST) {
+            result = false;
+            break;
+        }
+        *p = c;
+        if(c == '\0') break;
+    }
+
+    int serr = errno;
+    free(path);
+    errno = serr;
+    return result;
+}
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    while(size > 0) {
+        ssize_t n = write(fd, bytes, size);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool write_file_atomic(const char *file_path, const File_Part *parts, size_t count)
+{
+    char tmp_path[PATH_MAX];
+    if(snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", file_path) >= (int) sizeof(tmp_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    int fd = mkstemp(tmp_path);
+    if(fd < 0) return false;
+    fchmod(fd, 0644);
+
+    bool ok = true;
+    for(size_t i = 0; ok && i < count; ++i) ok = write_all(fd, parts[i].data, parts[i].size);
+    if(close(fd) < 0) ok = false;
+    if(ok && rename(tmp_path, file_path) < 0) ok = false;
+
+    if(!ok) {
+        int serr = errno;
+        unlink(tmp_path);
+        errno = serr;
+    }
+    return ok;
+}
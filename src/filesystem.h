@@ -1,6 +1,41 @@
 #ifndef FILESYSTEM_H_
 #define FILESYSTEM_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} File_Paths;
+
+typedef struct {
+    void *data;
+    size_t size;
+} File_Mapping;
+
+typedef struct {
+    const void *data;
+    size_t size;
+} File_Part;
+
 char *slurp_file(const char *file_path);
 
+// Appends the paths of the regular files in dir_path, sorted by name.
+bool list_directory(const char *dir_path, File_Paths *paths);
+void file_paths_free(File_Paths *paths);
+
+// Maps the whole file read-only. Empty files map to NULL data of size 0.
+bool map_file(const char *file_path, File_Mapping *mapping);
+void unmap_file(File_Mapping *mapping);
+
+// Creates dir_path and any missing parent directories, like `mkdir -p`.
+bool make_directories(const char *dir_path);
+
+// Writes the parts back to back into a temporary file next to file_path and
+// renames it over file_path, so a concurrent or interrupted writer never
+// leaves a half-written file under the real name.
+bool write_file_atomic(const char *file_path, const File_Part *parts, size_t count);
+
 #endif // FILESYSTEM_H_
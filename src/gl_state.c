@@ -0,0 +1,215 @@
+#include "gl_state.h"
+
+#include <assert.h>
+
+#include "texture_memory.h"
+
+// Shadow value of state the cache hasn't seen set yet.
+#define GLS_UNKNOWN ((GLuint) -1)
+
+typedef struct {
+    GLuint program;
+    GLuint vao;
+    GLuint buffers[GLS_BUFFER_COUNT];
+
+    GLuint active_unit;
+    GLuint textures[GLS_TEXTURE_UNITS][GLS_TEXTURE_COUNT];
+
+    GLuint blend;
+    GLenum blend_src;
+    GLenum blend_dst;
+    GLenum polygon_mode;
+    GLint viewport[4];
+
+    GLS_Stats stats;
+} GL_State;
+
+static GL_State state;
+
+// Counts the call, and reports whether it has to reach GL.
+static bool gls_changed(bool changed)
+{
+    state.stats.calls += 1;
+    if(!changed) state.stats.suppressed += 1;
+    return changed;
+}
+
+static int gls_buffer_index(GLenum target)
+{
+    switch(target) {
+        case GL_ARRAY_BUFFER:         return GLS_BUFFER_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER: return GLS_BUFFER_ELEMENT_ARRAY;
+        case GL_COPY_READ_BUFFER:     return GLS_BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER:    return GLS_BUFFER_COPY_WRITE;
+        case GL_PIXEL_UNPACK_BUFFER:  return GLS_BUFFER_PIXEL_UNPACK;
+        case GL_UNIFORM_BUFFER:       return GLS_BUFFER_UNIFORM;
+        default:                      return -1;
+    }
+}
+
+static int gls_texture_index(GLenum target)
+{
+    switch(target) {
+        case GL_TEXTURE_2D:       return GLS_TEXTURE_2D;
+        case GL_TEXTURE_2D_ARRAY: return GLS_TEXTURE_2D_ARRAY;
+        default:                  return -1;
+    }
+}
+
+void gls_invalidate(void)
+{
+    GLS_Stats stats = state.stats;
+
+    state.program = GLS_UNKNOWN;
+    state.vao = GLS_UNKNOWN;
+    for(size_t i = 0; i < GLS_BUFFER_COUNT; ++i) state.buffers[i] = GLS_UNKNOWN;
+
+    state.active_unit = GLS_UNKNOWN;
+    for(size_t u = 0; u < GLS_TEXTURE_UNITS; ++u) {
+        for(size_t t = 0; t < GLS_TEXTURE_COUNT; ++t) state.textures[u][t] = GLS_UNKNOWN;
+    }
+
+    state.blend = GLS_UNKNOWN;
+    state.blend_src = GL_NONE;
+    state.blend_dst = GL_NONE;
+    state.polygon_mode = GL_NONE;
+    state.viewport[2] = -1;
+
+    state.stats = stats;
+}
+
+void gls_use_program(GLuint program)
+{
+    if(!gls_changed(state.program != program)) return;
+    glUseProgram(program);
+    state.program = program;
+}
+
+void gls_bind_vertex_array(GLuint vao)
+{
+    if(!gls_changed(state.vao != vao)) return;
+    glBindVertexArray(vao);
+    state.vao = vao;
+    state.buffers[GLS_BUFFER_ELEMENT_ARRAY] = GLS_UNKNOWN;
+}
+
+void gls_bind_buffer(GLenum target, GLuint buffer)
+{
+    int index = gls_buffer_index(target);
+    if(index < 0) {
+        gls_changed(true);
+        glBindBuffer(target, buffer);
+        return;
+    }
+
+    if(!gls_changed(state.buffers[index] != buffer)) return;
+    glBindBuffer(target, buffer);
+    state.buffers[index] = buffer;
+}
+
+void gls_bind_texture(unsigned unit, GLenum target, GLuint texture)
+{
+    assert(unit < GLS_TEXTURE_UNITS);
+
+    int index = gls_texture_index(target);
+    if(index >= 0 && !gls_changed(state.textures[unit][index] != texture)) return;
+    if(index < 0) gls_changed(true);
+
+    if(state.active_unit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        state.active_unit = unit;
+    }
+    glBindTexture(target, texture);
+    if(index >= 0) state.textures[unit][index] = texture;
+}
+
+void gls_blend(bool enabled)
+{
+    if(!gls_changed(state.blend != (GLuint) enabled)) return;
+    if(enabled) glEnable(GL_BLEND);
+    else glDisable(GL_BLEND);
+    state.blend = enabled;
+}
+
+void gls_blend_func(GLenum src, GLenum dst)
+{
+    if(!gls_changed(state.blend_src != src || state.blend_dst != dst)) return;
+    glBlendFunc(src, dst);
+    state.blend_src = src;
+    state.blend_dst = dst;
+}
+
+void gls_polygon_mode(GLenum mode)
+{
+    if(!gls_changed(state.polygon_mode != mode)) return;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    state.polygon_mode = mode;
+}
+
+// GL_NONE until the mode has been set through the cache.
+GLenum gls_get_polygon_mode(void)
+{
+    return state.polygon_mode;
+}
+
+void gls_viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    GLint *v = state.viewport;
+    if(!gls_changed(v[0] != x || v[1] != y || v[2] != width || v[3] != height)) return;
+    glViewport(x, y, width, height);
+    v[0] = x; v[1] = y; v[2] = width; v[3] = height;
+}
+
+void gls_delete_program(GLuint program)
+{
+    // A current program outlives glDeleteProgram, but its name must not be
+    // trusted afterwards.
+    if(program != 0 && state.program == program) state.program = GLS_UNKNOWN;
+    glDeleteProgram(program);
+}
+
+void gls_delete_vertex_arrays(GLsizei n, const GLuint *vaos)
+{
+    for(GLsizei i = 0; i < n; ++i) {
+        if(vaos[i] != 0 && state.vao == vaos[i]) {
+            state.vao = 0;
+            state.buffers[GLS_BUFFER_ELEMENT_ARRAY] = GLS_UNKNOWN;
+        }
+    }
+    glDeleteVertexArrays(n, vaos);
+}
+
+void gls_delete_buffers(GLsizei n, const GLuint *buffers)
+{
+    for(GLsizei i = 0; i < n; ++i) {
+        if(buffers[i] == 0) continue;
+        for(size_t t = 0; t < GLS_BUFFER_COUNT; ++t) {
+            if(state.buffers[t] == buffers[i]) state.buffers[t] = 0;
+        }
+    }
+    glDeleteBuffers(n, buffers);
+}
+
+void gls_delete_textures(GLsizei n, const GLuint *textures)
+{
+    for(GLsizei i = 0; i < n; ++i) {
+        if(textures[i] == 0) continue;
+        texture_memory_untrack(textures[i]);
+        for(size_t u = 0; u < GLS_TEXTURE_UNITS; ++u) {
+            for(size_t t = 0; t < GLS_TEXTURE_COUNT; ++t) {
+                if(state.textures[u][t] == textures[i]) state.textures[u][t] = 0;
+            }
+        }
+    }
+    glDeleteTextures(n, textures);
+}
+
+GLS_Stats gls_stats(void)
+{
+    return state.stats;
+}
+
+void gls_reset_stats(void)
+{
+    state.stats = (GLS_Stats){0};
+}
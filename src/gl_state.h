@@ -0,0 +1,69 @@
+#ifndef GL_STATE_H_
+#define GL_STATE_H_
+
+#include <GL/glew.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Shadowed GL state
+ *
+ * Keeps a CPU-side copy of the bindings and fixed-function state the
+ * renderer touches, and drops calls that wouldn't change anything. GL is
+ * never queried; anything bound behind the cache's back has to be followed
+ * by gls_invalidate(). Objects have to be deleted through gls_delete_*()
+ * so the cache forgets their bindings, since GL unbinds them on deletion.
+ *
+ * The element array binding is part of the VAO, so it is only known until
+ * the next VAO change.
+ */
+
+#define GLS_TEXTURE_UNITS 16
+
+typedef enum {
+    GLS_BUFFER_ARRAY = 0,
+    GLS_BUFFER_ELEMENT_ARRAY,
+    GLS_BUFFER_COPY_READ,
+    GLS_BUFFER_COPY_WRITE,
+    GLS_BUFFER_PIXEL_UNPACK,
+    GLS_BUFFER_UNIFORM,
+    GLS_BUFFER_COUNT,
+} GLS_Buffer_Target;
+
+typedef enum {
+    GLS_TEXTURE_2D = 0,
+    GLS_TEXTURE_2D_ARRAY,
+    GLS_TEXTURE_COUNT,
+} GLS_Texture_Target;
+
+typedef struct {
+    size_t calls;       // state calls made through the cache
+    size_t suppressed;  // of those, dropped as redundant
+} GLS_Stats;
+
+// Forgets everything, so the next call of every kind reaches GL.
+void gls_invalidate(void);
+
+void gls_use_program(GLuint program);
+void gls_bind_vertex_array(GLuint vao);
+void gls_bind_buffer(GLenum target, GLuint buffer);
+void gls_bind_texture(unsigned unit, GLenum target, GLuint texture);
+
+void gls_blend(bool enabled);
+void gls_blend_func(GLenum src, GLenum dst);
+void gls_polygon_mode(GLenum mode);
+GLenum gls_get_polygon_mode(void);
+void gls_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+// Deleting drops the object from the cached bindings (and textures from
+// texture memory accounting), so a recycled name is bound again.
+void gls_delete_program(GLuint program);
+void gls_delete_vertex_arrays(GLsizei n, const GLuint *vaos);
+void gls_delete_buffers(GLsizei n, const GLuint *buffers);
+void gls_delete_textures(GLsizei n, const GLuint *textures);
+
+GLS_Stats gls_stats(void);
+void gls_reset_stats(void);
+
+#endif // GL_STATE_H_
@@ -0,0 +1,327 @@
+#include "gpu_allocator.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "dynamic_array.h"
+#include "gl_state.h"
+#include "logger.h"
+
+static unsigned order_for_count(size_t count)
+{
+    unsigned order = GPU_POOL_MIN_ORDER;
+    while(((size_t) 1 << order) < count) order += 1;
+    return order;
+}
+
+static bool free_list_remove(GPU_Free_List *list, size_t offset)
+{
+    for(size_t i = 0; i < list->count; ++i) {
+        if(list->items[i] == offset) {
+            list->items[i] = list->items[--list->count];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void pool_reset(GPU_Pool *pool)
+{
+    for(unsigned k = 0; k <= GPU_POOL_MAX_ORDER; ++k) {
+        pool->free_lists[k].count = 0;
+    }
+    da_append(&pool->free_lists[pool->order], 0);
+}
+
+static GLuint create_buffer(size_t size, GLenum usage)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    gls_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, usage);
+    return buffer;
+}
+
+static size_t pool_create(GPU_Allocator *a, unsigned order)
+{
+    // Reuse the slot of a released pool so block pool indices stay small.
+    size_t index = a->pools.count;
+    for(size_t i = 0; i < a->pools.count; ++i) {
+        if(a->pools.items[i].buffer == 0) {
+            index = i;
+            break;
+        }
+    }
+    if(index == a->pools.count) da_append(&a->pools, (GPU_Pool){0});
+
+    GPU_Pool *pool = &a->pools.items[index];
+    pool->order = order;
+    pool->buffer = create_buffer(((size_t) 1 << order) * a->element_size, a->usage);
+    pool->dirty = true;
+    pool->fragmented = false;
+    pool->live = 0;
+    pool_reset(pool);
+
+    LOG_TRACE("created GPU pool %zu of %zu elements", index, (size_t) 1 << order);
+    return index;
+}
+
+static bool pool_alloc(GPU_Pool *pool, unsigned order, size_t *offset)
+{
+    if(order > pool->order) return false;
+
+    unsigned k = order;
+    while(k <= pool->order && pool->free_lists[k].count == 0) k += 1;
+    if(k > pool->order) return false;
+
+    GPU_Free_List *list = &pool->free_lists[k];
+    size_t block = list->items[--list->count];
+
+    // Split down to the requested size, freeing the upper halves.
+    while(k > order) {
+        k -= 1;
+        da_append(&pool->free_lists[k], block + ((size_t) 1 << k));
+    }
+
+    *offset = block;
+    pool->live += 1;
+    return true;
+}
+
+static void pool_free(GPU_Pool *pool, size_t offset, unsigned order)
+{
+    while(order < pool->order) {
+        size_t buddy = offset ^ ((size_t) 1 << order);
+        if(!free_list_remove(&pool->free_lists[order], buddy)) break;
+        if(buddy < offset) offset = buddy;
+        order += 1;
+    }
+
+    da_append(&pool->free_lists[order], offset);
+    pool->live -= 1;
+    pool->fragmented = true;
+}
+
+void gpu_allocator_init(GPU_Allocator *a, size_t element_size, unsigned pool_order, GLenum usage)
+{
+    assert(pool_order >= GPU_POOL_MIN_ORDER && pool_order <= GPU_POOL_MAX_ORDER);
+
+    *a = (GPU_Allocator){0};
+    a->element_size = element_size;
+    a->pool_order = pool_order;
+    a->usage = usage;
+}
+
+void gpu_allocator_deallocate(GPU_Allocator *a)
+{
+    for(size_t i = 0; i < a->pools.count; ++i) {
+        GPU_Pool *pool = &a->pools.items[i];
+        if(pool->buffer) gls_delete_buffers(1, &pool->buffer);
+        for(unsigned k = 0; k <= GPU_POOL_MAX_ORDER; ++k) {
+            free(pool->free_lists[k].items);
+        }
+    }
+    free(a->pools.items);
+    free(a->blocks.items);
+
+    a->pools = (GPU_Pools){0};
+    a->blocks = (GPU_Blocks){0};
+}
+
+GPU_Allocation gpu_alloc(GPU_Allocator *a, size_t count)
+{
+    unsigned order = order_for_count(count);
+    if(order > GPU_POOL_MAX_ORDER) {
+        LOG_ERROR("GPU allocation of %zu elements is too large", count);
+        return GPU_ALLOCATION_NONE;
+    }
+
+    GPU_Block block = {.count = count, .order = order, .live = true};
+
+    bool found = false;
+    for(size_t i = 0; i < a->pools.count && !found; ++i) {
+        GPU_Pool *pool = &a->pools.items[i];
+        if(pool->buffer == 0) continue;
+        if(pool_alloc(pool, order, &block.offset)) {
+            block.pool = i;
+            found = true;
+        }
+    }
+
+    if(!found) {
+        // Oversized requests get a pool of their own.
+        block.pool = pool_create(a, order > a->pool_order ? order : a->pool_order);
+        found = pool_alloc(&a->pools.items[block.pool], order, &block.offset);
+        assert(found);
+    }
+
+    // Reuse a dead handle if there is one.
+    for(size_t i = 0; i < a->blocks.count; ++i) {
+        if(!a->blocks.items[i].live) {
+            a->blocks.items[i] = block;
+            return i;
+        }
+    }
+
+    da_append(&a->blocks, block);
+    return a->blocks.count - 1;
+}
+
+void gpu_free(GPU_Allocator *a, GPU_Allocation allocation)
+{
+    if(allocation == GPU_ALLOCATION_NONE) return;
+    assert(allocation < a->blocks.count);
+
+    GPU_Block *block = &a->blocks.items[allocation];
+    assert(block->live && "double free of GPU allocation");
+
+    pool_free(&a->pools.items[block->pool], block->offset, block->order);
+    block->live = false;
+}
+
+const GPU_Block *gpu_block(const GPU_Allocator *a, GPU_Allocation allocation)
+{
+    assert(allocation < a->blocks.count);
+    assert(a->blocks.items[allocation].live);
+    return &a->blocks.items[allocation];
+}
+
+static size_t pool_free_elements(const GPU_Pool *pool, size_t *largest)
+{
+    size_t total = 0;
+    *largest = 0;
+    for(unsigned k = 0; k <= pool->order; ++k) {
+        if(pool->free_lists[k].count == 0) continue;
+        total += pool->free_lists[k].count << k;
+        if(((size_t) 1 << k) > *largest) *largest = (size_t) 1 << k;
+    }
+    return total;
+}
+
+// Largest free block a perfectly compacted pool with this much free space
+// has: the live blocks packed at the start leave one free buddy for every
+// set bit of free_elements.
+static size_t compact_largest_free(size_t free_elements)
+{
+    size_t largest = 1;
+    if(free_elements == 0) return 0;
+    while(largest <= free_elements / 2) largest <<= 1;
+    return largest;
+}
+
+static int compare_blocks_by_size(const void *a, const void *b)
+{
+    const GPU_Block *x = *(const GPU_Block *const *) a;
+    const GPU_Block *y = *(const GPU_Block *const *) b;
+
+    if(x->order != y->order) return x->order > y->order ? -1 : 1;
+    if(x->offset != y->offset) return x->offset < y->offset ? -1 : 1;
+    return 0;
+}
+
+bool gpu_allocator_defragment(GPU_Allocator *a)
+{
+    bool moved = false;
+    GPU_Block **blocks = NULL;
+    size_t blocks_capacity = 0;
+
+    for(size_t p = 0; p < a->pools.count; ++p) {
+        GPU_Pool *pool = &a->pools.items[p];
+        if(pool->buffer == 0) continue;
+
+        if(pool->live == 0) {
+            // Keep one pool around so the next allocation doesn't have to create it.
+            if(p == 0) continue;
+            gls_delete_buffers(1, &pool->buffer);
+            pool->buffer = 0;
+            pool->dirty = true;
+            continue;
+        }
+
+        // Only frees open holes, and a pool that's already compact has nothing to gain.
+        size_t largest;
+        size_t free_elements = pool_free_elements(pool, &largest);
+        if(!pool->fragmented || largest == compact_largest_free(free_elements)) continue;
+
+        size_t count = 0;
+        for(size_t i = 0; i < a->blocks.count; ++i) {
+            GPU_Block *block = &a->blocks.items[i];
+            if(!block->live || block->pool != p) continue;
+            if(count >= blocks_capacity) {
+                blocks_capacity = blocks_capacity ? blocks_capacity * 2 : 64;
+                blocks = realloc(blocks, blocks_capacity * sizeof(*blocks));
+                assert(blocks != NULL && "Buy more RAM lol");
+            }
+            blocks[count++] = block;
+        }
+
+        // Placing buddy blocks largest first packs them without any holes.
+        qsort(blocks, count, sizeof(*blocks), compare_blocks_by_size);
+
+        GLuint buffer = create_buffer(((size_t) 1 << pool->order) * a->element_size, a->usage);
+        gls_bind_buffer(GL_COPY_READ_BUFFER, pool->buffer);
+
+        pool_reset(pool);
+        pool->live = 0;
+
+        for(size_t i = 0; i < count; ++i) {
+            size_t offset;
+            bool ok = pool_alloc(pool, blocks[i]->order, &offset);
+            assert(ok);
+            (void) ok;
+
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                blocks[i]->offset * a->element_size,
+                                offset * a->element_size,
+                                blocks[i]->count * a->element_size);
+            blocks[i]->offset = offset;
+        }
+
+        gls_delete_buffers(1, &pool->buffer);
+        pool->buffer = buffer;
+        pool->dirty = true;
+        pool->fragmented = false;
+        moved = true;
+    }
+
+    free(blocks);
+    return moved;
+}
+
+GPU_Allocator_Stats gpu_allocator_stats(const GPU_Allocator *a)
+{
+    GPU_Allocator_Stats stats = {0};
+    size_t contiguous_free = 0;
+    size_t compact_free = 0;
+
+    for(size_t p = 0; p < a->pools.count; ++p) {
+        const GPU_Pool *pool = &a->pools.items[p];
+        if(pool->buffer == 0) continue;
+
+        size_t largest;
+        size_t free_elements = pool_free_elements(pool, &largest);
+
+        stats.pools += 1;
+        stats.capacity += ((size_t) 1 << pool->order) * a->element_size;
+        stats.free += free_elements * a->element_size;
+        contiguous_free += largest * a->element_size;
+        compact_free += compact_largest_free(free_elements) * a->element_size;
+        if(largest * a->element_size > stats.largest_free) {
+            stats.largest_free = largest * a->element_size;
+        }
+    }
+
+    for(size_t i = 0; i < a->blocks.count; ++i) {
+        const GPU_Block *block = &a->blocks.items[i];
+        if(!block->live) continue;
+        stats.allocations += 1;
+        stats.used += ((size_t) 1 << block->order) * a->element_size;
+        stats.requested += block->count * a->element_size;
+    }
+
+    if(compact_free > 0) {
+        stats.fragmentation = 1.0f - (float) contiguous_free / (float) compact_free;
+    }
+
+    return stats;
+}
@@ -0,0 +1,100 @@
+#ifndef GPU_ALLOCATOR_H_
+#define GPU_ALLOCATOR_H_
+
+#include <GL/glew.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Buddy sub-allocator for GL buffers
+ *
+ * Hands out ranges of a few large GL buffers ("pools"), so many meshes can
+ * share one buffer (and one VAO) and be drawn with glDrawElementsBaseVertex.
+ * Sizes and offsets are counted in elements (e.g. vertices) rather than
+ * bytes, so every offset can be used as a base vertex directly.
+ *
+ * Allocations are referred to by handle, because defragmentation moves
+ * them around; look the current pool and offset up with gpu_block().
+ */
+
+#define GPU_POOL_MIN_ORDER 2   // smallest block is 4 elements, one quad
+#define GPU_POOL_MAX_ORDER 28
+
+typedef size_t GPU_Allocation;
+#define GPU_ALLOCATION_NONE ((GPU_Allocation) -1)
+
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} GPU_Free_List;
+
+typedef struct {
+    GLuint buffer;  // 0 once the pool has been released
+    unsigned order; // the pool holds 1 << order elements
+
+    // Owned by the user of the allocator. dirty is set whenever the pool's
+    // buffer is created or replaced, so the VAO needs to be pointed at it.
+    GLuint vao;
+    bool dirty;
+
+    GPU_Free_List free_lists[GPU_POOL_MAX_ORDER + 1];
+    size_t live;
+    bool fragmented;  // blocks were freed since the last compaction
+} GPU_Pool;
+
+typedef struct {
+    GPU_Pool *items;
+    size_t count;
+    size_t capacity;
+} GPU_Pools;
+
+typedef struct {
+    size_t pool;
+    size_t offset;  // in elements from the start of the pool's buffer
+    size_t count;   // elements asked for
+    unsigned order; // the block spans 1 << order elements
+    bool live;
+} GPU_Block;
+
+typedef struct {
+    GPU_Block *items;
+    size_t count;
+    size_t capacity;
+} GPU_Blocks;
+
+typedef struct {
+    size_t element_size;
+    unsigned pool_order;
+    GLenum usage;
+
+    GPU_Pools pools;
+    GPU_Blocks blocks;
+} GPU_Allocator;
+
+typedef struct {
+    size_t pools;
+    size_t allocations;
+    size_t capacity;      // bytes across all pools
+    size_t used;          // bytes in allocated blocks
+    size_t requested;     // bytes actually asked for
+    size_t free;          // bytes in free blocks
+    size_t largest_free;  // bytes in the largest free block of any pool
+    float fragmentation;  // how far each pool's largest free block falls short of the compacted pool's, 0 when compact
+} GPU_Allocator_Stats;
+
+void gpu_allocator_init(GPU_Allocator *a, size_t element_size, unsigned pool_order, GLenum usage);
+void gpu_allocator_deallocate(GPU_Allocator *a);
+
+GPU_Allocation gpu_alloc(GPU_Allocator *a, size_t count);
+void gpu_free(GPU_Allocator *a, GPU_Allocation allocation);
+const GPU_Block *gpu_block(const GPU_Allocator *a, GPU_Allocation allocation);
+
+// Compacts the live blocks of every fragmented pool to the front of a fresh
+// buffer and releases pools that are empty. Returns true if any block moved.
+bool gpu_allocator_defragment(GPU_Allocator *a);
+
+GPU_Allocator_Stats gpu_allocator_stats(const GPU_Allocator *a);
+
+#endif // GPU_ALLOCATOR_H_
@@ -0,0 +1,28 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 64-bit FNV-1a
+ *
+ * Cheap, byte-at-a-time hash for cache keys. Not for anything that has to
+ * stand up to deliberately colliding input. Chain calls to hash several
+ * pieces, starting from FNV_OFFSET_BASIS.
+ */
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static inline uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+#endif // HASH_H_
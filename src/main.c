@@ -5,8 +5,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <errno.h>
 #include <string.h>
+#include <math.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -20,18 +23,33 @@
 #define STRING_VIEW_IMPLEMENTATION
 #include "string_view.h"
 
+#include "atlas.h"
+#include "dynamic_array.h"
+#include "file_watcher.h"
 #include "filesystem.h"
+#include "gl_state.h"
+#include "gpu_allocator.h"
 #include "logger.h"
+#include "shader_cache.h"
+#include "shader_preprocess.h"
+#include "shader_reflect.h"
+#include "texture_array.h"
+#include "texture_loader.h"
+#include "upload_scheduler.h"
 
 #define DEFAULT_WINDOW_WIDTH 800
 #define DEFAULT_WINDOW_HEIGHT 800
 
+#define TEXTURE_LOADER_WORKERS 2
+#define TEXTURE_BUDGET (256 * 1024 * 1024)
+#define UPLOAD_FRAME_BYTES (8 * 1024 * 1024)
+#define UPLOAD_FRAME_SECONDS 0.002
+
 #define return_defer(value) do { result = (value); goto defer; } while(0)
 
-const char *screen_shader_path         = "resources/shaders/screen.vert";
-const char *basic_fragment_shader_path = "resources/shaders/basic.frag";
-const char *wireframe_shader_path      = "resources/shaders/wireframe.frag";
-const char *texture_shader_path        = "resources/shaders/texture.frag";
+const char *shaders_dir_path            = "resources/shaders";
+const char *sprite_vertex_shader_path   = "resources/shaders/sprite.vert";
+const char *sprite_fragment_shader_path = "resources/shaders/sprite.frag";
 
 const char *shader_type_as_cstr(GLenum shader_type)
 {
@@ -50,29 +68,161 @@ typedef struct {
     V2f pos;
     V2f uv;
     V4f color;
+    uint16_t slot;   // texture slot sampled by sprite.frag, 0 for the keyed texture
+    uint16_t layer;  // array texture layer sampled by sprite.frag
 } Vertex;
 
 typedef enum {
     VA_POS = 0,
     VA_UV,
     VA_COLOR,
+    VA_SLOT,
+    VA_LAYER,
     VA_COUNT,
 } Vertex_Attrib;
 
-bool compile_shader_source(const GLchar *source, GLenum shader_type, GLuint *shader)
+static inline uint8_t pack_unorm8(float x)
+{
+    if(x <= 0.0f) return 0;
+    if(x >= 1.0f) return 0xFF;
+    return (uint8_t) (x * 255.0f + 0.5f);
+}
+
+static inline uint16_t pack_unorm16(float x)
+{
+    if(x <= 0.0f) return 0;
+    if(x >= 1.0f) return 0xFFFF;
+    return (uint16_t) (x * 65535.0f + 0.5f);
+}
+
+static inline int16_t pack_snorm16(float x)
+{
+    if(x <= -1.0f) return -32767;
+    if(x >= 1.0f) return 32767;
+    return (int16_t) lrintf(x * 32767.0f);
+}
+
+// Layouts the batch buffer can store Vertex in. r_vertex always takes a
+// float Vertex and encodes it into the selected format.
+typedef enum {
+    VERTEX_FORMAT_F32 = 0,    // Vertex as is, 36 bytes
+    VERTEX_FORMAT_PACKED,     // f32 position, unorm16 uv, RGBA8 color, u8 slot, u16 layer, 20 bytes
+    VERTEX_FORMAT_QUANTIZED,  // snorm16 position * position scale, unorm16 uv, RGBA8 color, u8 slot, u16 layer, 16 bytes
+    VERTEX_FORMAT_COUNT,
+} Vertex_Format;
+
+// Packed uvs are clamped to [0, 1], so repeating textures need VERTEX_FORMAT_F32.
+typedef struct {
+    V2f pos;
+    uint16_t uv[2];
+    uint8_t color[4];
+    uint8_t slot;
+    uint8_t padding;
+    uint16_t layer;
+} Packed_Vertex;
+
+typedef struct {
+    int16_t pos[2];
+    uint16_t uv[2];
+    uint8_t color[4];
+    uint8_t slot;
+    uint8_t padding;
+    uint16_t layer;
+} Quantized_Vertex;
+
+typedef struct {
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+} Vertex_Attrib_Layout;
+
+typedef struct {
+    size_t stride;
+    Vertex_Attrib_Layout attribs[VA_COUNT];
+} Vertex_Layout;
+
+static const Vertex_Layout vertex_layouts[VERTEX_FORMAT_COUNT] = {
+    [VERTEX_FORMAT_F32] = {
+        sizeof(Vertex), {
+            [VA_POS]   = {2, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos)},
+            [VA_UV]    = {2, GL_FLOAT, GL_FALSE, offsetof(Vertex, uv)},
+            [VA_COLOR] = {4, GL_FLOAT, GL_FALSE, offsetof(Vertex, color)},
+            [VA_SLOT]  = {1, GL_UNSIGNED_SHORT, GL_FALSE, offsetof(Vertex, slot)},
+            [VA_LAYER] = {1, GL_UNSIGNED_SHORT, GL_FALSE, offsetof(Vertex, layer)},
+        },
+    },
+    [VERTEX_FORMAT_PACKED] = {
+        sizeof(Packed_Vertex), {
+            [VA_POS]   = {2, GL_FLOAT,          GL_FALSE, offsetof(Packed_Vertex, pos)},
+            [VA_UV]    = {2, GL_UNSIGNED_SHORT, GL_TRUE,  offsetof(Packed_Vertex, uv)},
+            [VA_COLOR] = {4, GL_UNSIGNED_BYTE,  GL_TRUE,  offsetof(Packed_Vertex, color)},
+            [VA_SLOT]  = {1, GL_UNSIGNED_BYTE,  GL_FALSE, offsetof(Packed_Vertex, slot)},
+            [VA_LAYER] = {1, GL_UNSIGNED_SHORT, GL_FALSE, offsetof(Packed_Vertex, layer)},
+        },
+    },
+    [VERTEX_FORMAT_QUANTIZED] = {
+        sizeof(Quantized_Vertex), {
+            [VA_POS]   = {2, GL_SHORT,          GL_TRUE,  offsetof(Quantized_Vertex, pos)},
+            [VA_UV]    = {2, GL_UNSIGNED_SHORT, GL_TRUE,  offsetof(Quantized_Vertex, uv)},
+            [VA_COLOR] = {4, GL_UNSIGNED_BYTE,  GL_TRUE,  offsetof(Quantized_Vertex, color)},
+            [VA_SLOT]  = {1, GL_UNSIGNED_BYTE,  GL_FALSE, offsetof(Quantized_Vertex, slot)},
+            [VA_LAYER] = {1, GL_UNSIGNED_SHORT, GL_FALSE, offsetof(Quantized_Vertex, layer)},
+        },
+    },
+};
+
+// One quad of the instanced path, expanded to a unit quad by sprite.vert.
+// 36 bytes against the 144 bytes of float vertices the same quad costs
+// otherwise.
+typedef struct {
+    V2f center;
+    V2f half_size;
+    uint8_t color[4];     // RGBA8 unorm
+    uint16_t uv_rect[4];  // u0, v0, u1, v1 as unorm16
+    float rotation;       // radians, counter-clockwise
+    uint8_t slot;
+    uint8_t padding;
+    uint16_t layer;
+} Quad_Instance;
+
+typedef enum {
+    IA_CENTER = 0,
+    IA_HALF_SIZE,
+    IA_COLOR,
+    IA_UV_RECT,
+    IA_ROTATION,
+    IA_SLOT,
+    IA_LAYER,
+    IA_COUNT,
+} Instance_Attrib;
+
+typedef struct {
+    Quad_Instance *items;
+    size_t count;
+    size_t capacity;
+} Quad_Instances;
+
+// Submits the compile without waiting for it; see shader_compiled().
+GLuint compile_shader_begin(const GLchar *source, GLenum shader_type)
 {
-    *shader = glCreateShader(shader_type);
-    glShaderSource(*shader, 1, &source, NULL);
-    glCompileShader(*shader);
+    GLuint shader = glCreateShader(shader_type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+}
 
+// Waits for the compile to finish and logs its errors.
+bool shader_compiled(GLuint shader, GLenum shader_type)
+{
     int compiled;
-    glGetShaderiv(*shader, GL_COMPILE_STATUS, &compiled);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
 
     if(!compiled) {
         GLsizei message_size;
-        glGetShaderiv(*shader, GL_INFO_LOG_LENGTH, &message_size);
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &message_size);
         GLchar message[message_size];
-        glGetShaderInfoLog(*shader, message_size, &message_size, message);
+        glGetShaderInfoLog(shader, message_size, &message_size, message);
 
         LOG_ERROR("ERROR: failed to compile %s", shader_type_as_cstr(shader_type));
         LOG_ERROR("%.*s", message_size, message);
@@ -82,90 +232,485 @@ bool compile_shader_source(const GLchar *source, GLenum shader_type, GLuint *sha
     return true;
 }
 
-bool compile_shader_file(const char *file_path, GLenum shader_type, GLuint *shader)
+// Submits the link without waiting for it; see program_linked(). The
+// shaders may still be compiling.
+GLuint link_program_begin(GLuint vertex_shader, GLuint fragment_shader)
 {
-    char *source = slurp_file(file_path);
-    if(source == NULL) {
-        LOG_ERROR("failed to read file `%s`: %s", file_path, strerror(errno));
-        return false;
-    }
+    GLuint program = glCreateProgram();
+    shader_cache_prepare(program);
 
-    bool ok = compile_shader_source(source, shader_type, shader);
-    if(!ok) LOG_ERROR("failed to compile shader `%s`", file_path);
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
 
-    free(source);
-    return ok;
+    return program;
 }
 
-bool link_program(GLuint vertex_shader, GLuint fragment_shader, GLuint *program)
+// Waits for the link to finish and logs its errors.
+bool program_linked(GLuint program)
 {
-    *program = glCreateProgram();
-
-    glAttachShader(*program, vertex_shader);
-    glAttachShader(*program, fragment_shader);
-    glLinkProgram(*program);
-
     GLint linked = 0;
-    glGetProgramiv(*program, GL_LINK_STATUS, &linked);
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
     if(!linked) {
         GLsizei message_size;
-        glGetProgramiv(*program, GL_INFO_LOG_LENGTH, &message_size);
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &message_size);
         GLchar message[message_size];
 
-        glGetProgramInfoLog(*program, message_size, &message_size, message);
+        glGetProgramInfoLog(program, message_size, &message_size, message);
         LOG_ERROR("ERROR: failed to link shader program: %.*s\n", message_size, message);
     }
 
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+    return linked;
+}
 
-    return program;
+typedef struct {
+    const char *name;  // for messages
+    const char *vertex_source;
+    const char *fragment_source;
+    GLuint *program;   // only written once the program is ready
+} Program_Build;
+
+// Where load_shader_programs() is with one of its programs.
+typedef struct {
+    size_t vertex_shader;    // into the batch's shaders
+    size_t fragment_shader;
+    uint64_t key;
+    GLuint linking;
+    bool done;
+} Program_Link;
+
+typedef struct {
+    const char *name;  // of the first program using it
+    GLenum type;
+    const char *source;
+    GLuint shader;     // 0 until a program that isn't cached needs it
+    int compiled;      // -1 until checked
+} Shader_Source;
+
+typedef struct {
+    Shader_Source *items;
+    size_t count;
+    size_t capacity;
+} Shader_Sources;
+
+// Index of the shader with this source, so programs sharing one compile it once.
+static size_t shader_sources_get(Shader_Sources *shaders, const char *name, const char *source, GLenum type)
+{
+    for(size_t i = 0; i < shaders->count; ++i) {
+        if(shaders->items[i].type == type && strcmp(shaders->items[i].source, source) == 0) return i;
+    }
+
+    da_append(shaders, ((Shader_Source){name, type, source, 0, -1}));
+    return shaders->count - 1;
+}
+
+// Checks the compile of a shader the first time a program using it failed
+// to link, so every broken shader is reported once.
+static bool shader_source_compiled(Shader_Source *shader)
+{
+    if(shader->compiled < 0) {
+        shader->compiled = shader_compiled(shader->shader, shader->type);
+        if(!shader->compiled) LOG_ERROR("failed to compile the %s of %s", shader_type_as_cstr(shader->type), shader->name);
+    }
+    return shader->compiled;
 }
 
-bool load_shader_program(const char *vertex_shader_path,
-                         const char *fragment_shader_path,
-                         GLuint *program)
+static bool program_link_finish(const Program_Build *build, Program_Link *link, Shader_Sources *shaders)
 {
-    GLuint vertex_shader = 0;
-    GLuint fragment_shader = 0;
+    link->done = true;
 
-    if(!compile_shader_file(vertex_shader_path, GL_VERTEX_SHADER, &vertex_shader)) return false;
-    if(!compile_shader_file(fragment_shader_path, GL_FRAGMENT_SHADER, &fragment_shader)) return false;
+    GLint linked = 0;
+    glGetProgramiv(link->linking, GL_LINK_STATUS, &linked);
+    if(!linked) {
+        // A broken shader explains the failed link better than the link log.
+        bool vertex = shader_source_compiled(&shaders->items[link->vertex_shader]);
+        bool fragment = shader_source_compiled(&shaders->items[link->fragment_shader]);
+        if(vertex && fragment) {
+            program_linked(link->linking);
+            LOG_ERROR("failed to link %s", build->name);
+        }
 
-    if(!link_program(vertex_shader, fragment_shader, program)) return false;
+        glDeleteProgram(link->linking);
+        link->linking = 0;
+        return false;
+    }
 
+    *build->program = link->linking;
+    shader_cache_store(link->key, link->linking);
     return true;
 }
 
+// Loads every program from the shader cache or builds it from source.
+//
+// Shared shaders are compiled once, and every compile and link is submitted
+// before any of them is waited on, so drivers with KHR_parallel_shader_compile
+// work through them on their own threads. Programs are then finished as
+// GL_COMPLETION_STATUS_KHR reports them done. Other drivers finish them in
+// order, each query waiting for its program.
+//
+// Programs that fail are reported and left as they were; the rest are loaded
+// either way.
+bool load_shader_programs(const Program_Build *builds, size_t count)
+{
+    bool result = true;
+    Shader_Sources shaders = {0};
+
+    Program_Link *links = calloc(count, sizeof(Program_Link));
+    assert(links != NULL && "Buy more RAM lol");
+
+    for(size_t i = 0; i < count; ++i) {
+        const Program_Build *build = &builds[i];
+        Program_Link *link = &links[i];
+
+        link->vertex_shader = shader_sources_get(&shaders, build->name, build->vertex_source, GL_VERTEX_SHADER);
+        link->fragment_shader = shader_sources_get(&shaders, build->name, build->fragment_source, GL_FRAGMENT_SHADER);
+
+        link->key = shader_cache_key(build->vertex_source, build->fragment_source);
+        if(shader_cache_load(link->key, build->program)) {
+            LOG_TRACE("program %s loaded from cache", build->name);
+            link->done = true;
+        }
+    }
+
+    size_t pending = 0;
+    for(size_t i = 0; i < count; ++i) {
+        Program_Link *link = &links[i];
+        if(link->done) continue;
+
+        Shader_Source *vertex = &shaders.items[link->vertex_shader];
+        Shader_Source *fragment = &shaders.items[link->fragment_shader];
+        if(vertex->shader == 0) vertex->shader = compile_shader_begin(vertex->source, vertex->type);
+        if(fragment->shader == 0) fragment->shader = compile_shader_begin(fragment->source, fragment->type);
+
+        link->linking = link_program_begin(vertex->shader, fragment->shader);
+        pending += 1;
+    }
+
+    bool parallel = GLEW_KHR_parallel_shader_compile;
+    bool wait = !parallel;
+    while(pending > 0) {
+        size_t finished = 0;
+        for(size_t i = 0; i < count; ++i) {
+            Program_Link *link = &links[i];
+            if(link->done) continue;
+
+            if(!wait) {
+                GLint completed = GL_FALSE;
+                glGetProgramiv(link->linking, GL_COMPLETION_STATUS_KHR, &completed);
+                if(!completed) continue;
+            }
+            // Waiting on one is enough, the rest may have finished meanwhile.
+            wait = !parallel;
+
+            if(!program_link_finish(&builds[i], link, &shaders)) result = false;
+            finished += 1;
+            pending -= 1;
+        }
+
+        // Nothing to do until a program is done, so block on the first one.
+        if(finished == 0) wait = true;
+    }
+
+    for(size_t i = 0; i < shaders.count; ++i) {
+        // Attached shaders are only flagged, they go away with their programs.
+        if(shaders.items[i].shader) glDeleteShader(shaders.items[i].shader);
+    }
+    free(shaders.items);
+    free(links);
+    return result;
+}
+
 typedef enum {
     PROGRAM_BASIC = 0,
     PROGRAM_WIREFRAME,
     PROGRAM_TEXTURE,
+    PROGRAM_TEXTURE_ARRAY,
     PROGRAM_COUNT,
 } Shader_Program;
 
-#define VERTEX_CAP (8 * 1024)
-#define INDEX_CAP (16 * 1024)
+// Every program is a variant of the sprite shaders, picked by the features
+// defined when preprocessing them.
+typedef enum {
+    SHADER_INSTANCED     = 1 << 0,
+    SHADER_TEXTURE       = 1 << 1,
+    SHADER_TEXTURE_ARRAY = 1 << 2,
+    SHADER_WIREFRAME     = 1 << 3,
+} Shader_Feature;
+
+#define SHADER_FEATURE_COUNT 4
+#define SHADER_VARIANT_COUNT (1 << SHADER_FEATURE_COUNT)
+
+// Only these are defined for the vertex shader, so variants differing in
+// the rest share its source and compile it once.
+#define SHADER_VERTEX_FEATURES SHADER_INSTANCED
+
+static const char *shader_feature_names[SHADER_FEATURE_COUNT] = {
+    "INSTANCED", "TEXTURE", "TEXTURE_ARRAY", "WIREFRAME",
+};
+
+static const Shader_Feature program_features[PROGRAM_COUNT] = {
+    [PROGRAM_BASIC]         = 0,
+    [PROGRAM_WIREFRAME]     = SHADER_WIREFRAME,
+    [PROGRAM_TEXTURE]       = SHADER_TEXTURE,
+    [PROGRAM_TEXTURE_ARRAY] = SHADER_TEXTURE_ARRAY,
+};
+
 typedef struct {
-    GLuint vao;
-    GLuint vbo;
-    GLuint ebo;
+    GLuint program;        // 0 until first drawn with
+    Program_Reflection reflection;
+    GLint position_scale;  // -1 when the variant doesn't use it
+    bool failed;           // tried to build, but never succeeded
+    File_Paths files;      // read while building it, for hot reload
+} Shader_Variant;
+
+// Initial batch capacity. A full batch is flushed, or grown when the
+// renderer is growable.
+#define VERTEX_CAP (8 * 1024)
 
-    GLuint programs[PROGRAM_COUNT];
+// Every quad is drawn with the same six indices relative to its first
+// vertex, so they live in one static buffer shared by all batches.
+#define QUAD_VERTICES 4
+#define QUAD_INDICES 6
 
-    Vertex vertices[VERTEX_CAP];
-    size_t vertex_count;
+// Number of frame regions the streaming VBO is carved into.
+// The CPU writes region N while the GPU may still read N-1 and N-2.
+#define R_FRAME_REGIONS 3
+
+// Texture slots sprite.frag can select from. Slot 0 is the texture of the
+// sort key, slots 1.. hold the textures of the slot table.
+#define R_TEXTURE_SLOTS 16
+
+// Uniform buffer binding point of the Frame block.
+#define R_FRAME_BINDING 0
+
+// Spans closer than this many elements are uploaded as one; a handful of
+// wasted bytes is cheaper than another glBufferSubData call.
+#define DIRTY_SPAN_CAP 16
+#define DIRTY_SPAN_MERGE_GAP 8
+
+typedef struct {
+    size_t begin;
+    size_t end;
+} Dirty_Span;
 
-    GLuint indices[INDEX_CAP];
+typedef struct {
+    Dirty_Span items[DIRTY_SPAN_CAP];
+    size_t count;
+} Dirty_Spans;
+
+// Draw commands are sorted by a 64-bit key, most significant field first:
+//
+//     | layer:8 | program:8 | texture:16 | depth:32 |
+//
+// Layers are drawn in order. Within a layer commands are grouped by state,
+// and the sort is stable, so equal keys keep their submission order. The
+// texture field holds an index into the renderer's keyed texture table
+// rather than a GL name, 0 for none. The table starts over every flush.
+#define SORT_KEY_LAYER_SHIFT   56
+#define SORT_KEY_PROGRAM_SHIFT 48
+#define SORT_KEY_TEXTURE_SHIFT 32
+#define SORT_KEY_STATE_MASK    0xFFFFFFFF00000000ull
+#define SORT_KEY_DEPTH_MASK    0x00000000FFFFFFFFull
+#define SORT_KEY_TEXTURE_CAP   0xFFFF  // textures keyed per flush
+
+// Set in the program field for commands drawn from the instance buffer.
+#define SORT_KEY_INSTANCED     0x80
+
+// first_index/index_count index the shared quad index buffer, or are an
+// instance range for instanced commands. mesh is 0 for the batch, or the
+// Mesh_Handle + 1 of a retained mesh.
+typedef struct {
+    uint64_t key;
+    size_t first_index;
     size_t index_count;
+    size_t mesh;
+} Draw_Command;
+
+typedef struct {
+    Draw_Command *items;
+    size_t count;
+    size_t capacity;
+} Draw_Commands;
+
+typedef struct {
+    GLuint *items;
+    size_t count;
+    size_t capacity;
+} Keyed_Textures;
+
+// Retained quads sub-allocated from the shared GL_STATIC_DRAW mesh pools,
+// drawn against the shared quad index buffer.
+typedef struct {
+    GPU_Allocation allocation;  // GPU_ALLOCATION_NONE for a free slot
+    size_t quad_count;
+    size_t quad_capacity;
+    float position_scale;       // quantized positions are relative to, fixed at creation
+} Mesh;
 
+typedef struct {
+    Mesh *items;
+    size_t count;
+    size_t capacity;
+} Meshes;
+
+typedef size_t Mesh_Handle;
+typedef size_t Quad_Handle;
+
+// Every mesh pool holds 1 << MESH_POOL_ORDER vertices.
+#define MESH_POOL_ORDER 16
+// Pools are compacted once their largest free blocks are under half of
+// what compacting them would give.
+#define MESH_DEFRAGMENT_THRESHOLD 0.5f
+// Most meshes submitted by a single glMultiDrawElementsBaseVertex.
+#define MESH_MULTI_DRAW_CAP 64
+
+typedef struct {
+    size_t bytes_uploaded;  // 0 for a frame that changed nothing, unless streaming
+    size_t upload_calls;
+    size_t draw_calls;
+    size_t commands;
+    size_t state_changes;
+    size_t vertices;
+    size_t indices;
+    size_t instances;
+    size_t mesh_quads;
+    size_t slot_flushes;
+} Renderer_Stats;
+
+// The Frame block of frame.glsl, laid out std140: the matrix takes 64
+// bytes, resolution starts right after it and time packs into its tail.
+typedef struct {
+    float view[16];  // column-major
+    float resolution[2];
+    float time;
+    float padding;
+} Frame_Uniforms;
+
+// Where Frame_Uniforms expects every member of the block, checked against
+// the offsets the driver reports.
+static const struct {
+    const char *name;
+    size_t offset;
+} frame_members[] = {
+    {"view",       offsetof(Frame_Uniforms, view)},
+    {"resolution", offsetof(Frame_Uniforms, resolution)},
+    {"time",       offsetof(Frame_Uniforms, time)},
+};
+
+typedef struct {
+    GLuint vao;
+    GLuint vbo;
+    GLuint quad_ebo;
+    size_t quad_ebo_capacity;  // in quads
+
+    // Indexed by Shader_Feature mask, built the first time it's drawn with.
+    Shader_Variant variants[SHADER_VARIANT_COUNT];
+
+    // Bound to R_FRAME_BINDING once and shared by every variant. Setting a
+    // frame constant only marks it dirty; it's uploaded with the next flush.
+    GLuint frame_ubo;
+    Frame_Uniforms frame;
+    bool frame_dirty;
+
+    // Instanced mode: quads become one Quad_Instance each instead of
+    // vertices and indices, drawn with glDrawArraysInstanced.
+    bool instanced;
+    GLuint instance_vao;
+    GLuint instance_vbo;
+    size_t instance_vbo_capacity;
+    Quad_Instances instances;
+
+    // Points at cpu_vertices, or at the mapped frame region when streaming
+    // (NULL while no region is acquired). Always holds whole quads.
+    unsigned char *vertices;
+    size_t vertex_count;
+    size_t vertex_capacity;
+
+    // Layout of the vertex storage, and the scale quantized positions are
+    // relative to. Changing the scale flushes the batch.
+    Vertex_Format vertex_format;
+    size_t vertex_size;
+    float position_scale;
+
+    // Grow the batch storage instead of flushing when it fills up.
+    // Streaming regions have a fixed size and always flush.
+    bool growable;
+
+    // Streaming mode: r_vertex writes straight into GPU-visible memory.
+    bool streaming;
+    bool persistent;  // ARB_buffer_storage persistent/coherent mapping
+    size_t region;
+    GLsync fences[R_FRAME_REGIONS];
+    unsigned char *mapped_vertices;
+
+    // Non-streaming mode: cpu_vertices mirrors the GPU buffer and only the
+    // spans that changed since the last sync are uploaded.
+    Dirty_Spans dirty_vertices;
+
+    // Draw commands of the pending batch, and the state new ones are keyed with.
+    Draw_Commands commands;
+    Draw_Commands sort_scratch;
+    uint8_t layer;
+    Shader_Program program;
+    GLuint texture;
+    float depth;
+
+    // Textures the pending commands bind, in the order they were first set.
+    // A sort key names texture items[i] as i + 1.
+    Keyed_Textures keyed_textures;
+    uint16_t texture_key;
+
+    // Array texture sampled by PROGRAM_TEXTURE_ARRAY, and the layer new
+    // quads select from it.
+    GLuint texture_array;
+    uint16_t texture_array_key;
+    uint16_t texture_layer;
+
+    // Texture slot mode: the textures of the batch are bound to units 1..
+    // all at once and every quad carries the slot it samples, so switching
+    // textures doesn't split the batch. It's only flushed once the slot
+    // table overflows.
+    bool texture_slots;
+    size_t texture_slot_cap;
+    GLuint slot_textures[R_TEXTURE_SLOTS];
+    size_t slot_count;
+    uint8_t texture_slot;
+
+    Meshes meshes;
+    GPU_Allocator mesh_allocator;
+
+    Renderer_Stats stats;
+
+    unsigned char *cpu_vertices;
 } Renderer;
 
+// The batch is uploaded one of two ways. By default it's mirrored on the
+// CPU and only the vertices that differ from the last frame are uploaded,
+// so a frame that redraws the same quads uploads zero bytes. Streaming
+// writes every vertex straight into a mapped ring buffer instead, which
+// pays off when most of the batch changes every frame; it always reports
+// the whole batch as uploaded.
+typedef struct {
+    bool streaming;
+    bool growable;
+    bool instanced;
+    bool texture_slots;
+    Vertex_Format vertex_format;
+} Renderer_Config;
+
 /* Global Variables */
 
-static Renderer global_renderer = {0};
 static double time = 0.0f;
 static bool pause = false;
+static bool show_stats = false;
+
+static Renderer_Config renderer_config = {
+    .streaming = false,
+    .growable = true,
+    .instanced = false,
+    .texture_slots = true,
+    .vertex_format = VERTEX_FORMAT_F32,
+};
 
 static const char *vertex_shader_path[PROGRAM_COUNT] = {0};
 static const char *fragment_shader_path[PROGRAM_COUNT] = {0};
@@ -174,38 +719,267 @@ static char *render_conf = NULL;
 
 /* Renderer Functions */
 
+// Points the instance attributes at the given instance. Without
+// ARB_base_instance this is how a draw starts in the middle of the buffer.
+static void r_instance_attrib_pointers(size_t first_instance)
+{
+    size_t base = first_instance * sizeof(Quad_Instance);
+
+    glVertexAttribPointer(IA_CENTER, 2, GL_FLOAT, GL_FALSE, sizeof(Quad_Instance),
+                          (void *) (base + offsetof(Quad_Instance, center)));
+    glVertexAttribPointer(IA_HALF_SIZE, 2, GL_FLOAT, GL_FALSE, sizeof(Quad_Instance),
+                          (void *) (base + offsetof(Quad_Instance, half_size)));
+    glVertexAttribPointer(IA_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Quad_Instance),
+                          (void *) (base + offsetof(Quad_Instance, color)));
+    glVertexAttribPointer(IA_UV_RECT, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Quad_Instance),
+                          (void *) (base + offsetof(Quad_Instance, uv_rect)));
+    glVertexAttribPointer(IA_ROTATION, 1, GL_FLOAT, GL_FALSE, sizeof(Quad_Instance),
+                          (void *) (base + offsetof(Quad_Instance, rotation)));
+    glVertexAttribPointer(IA_SLOT, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Quad_Instance),
+                          (void *) (base + offsetof(Quad_Instance, slot)));
+    glVertexAttribPointer(IA_LAYER, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(Quad_Instance),
+                          (void *) (base + offsetof(Quad_Instance, layer)));
+}
+
+static void r_init_streaming_buffers(Renderer *r)
+{
+    GLsizeiptr vbo_size = R_FRAME_REGIONS * r->vertex_capacity * r->vertex_size;
+
+    r->persistent = GLEW_ARB_buffer_storage;
+    if(r->persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glBufferStorage(GL_ARRAY_BUFFER, vbo_size, NULL, flags);
+        r->mapped_vertices = glMapBufferRange(GL_ARRAY_BUFFER, 0, vbo_size, flags);
+
+        if(r->mapped_vertices != NULL) {
+            LOG_INFO("Streaming vertices through persistent mapped buffers");
+            return;
+        }
+
+        // Immutable storage can't be respecified, so start over with a fresh buffer.
+        LOG_WARN("failed to map persistent buffers, falling back to glMapBufferRange");
+        r->persistent = false;
+
+        gls_delete_buffers(1, &r->vbo);
+        glGenBuffers(1, &r->vbo);
+        gls_bind_buffer(GL_ARRAY_BUFFER, r->vbo);
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, vbo_size, NULL, GL_STREAM_DRAW);
+    LOG_INFO("Streaming vertices through unsynchronized buffer mappings");
+}
+
+// Sets up the bound VAO to read the bound GL_ARRAY_BUFFER in the given format.
+static void r_vertex_attrib_pointers(Vertex_Format format)
+{
+    const Vertex_Layout *layout = &vertex_layouts[format];
+    for(Vertex_Attrib a = 0; a < VA_COUNT; ++a) {
+        glVertexAttribPointer(a,
+                              layout->attribs[a].size,
+                              layout->attribs[a].type,
+                              layout->attribs[a].normalized,
+                              layout->stride,
+                              (void *) layout->attribs[a].offset);
+        glEnableVertexAttribArray(a);
+    }
+}
+
+// (Re)builds the static index buffer so it covers quad_count quads.
+static void r_init_quad_indices(Renderer *r, size_t quad_count)
+{
+    GLuint *indices = malloc(quad_count * QUAD_INDICES * sizeof(GLuint));
+    assert(indices != NULL && "Buy more RAM lol");
+
+    for(size_t q = 0; q < quad_count; ++q) {
+        GLuint v = (GLuint) (q * QUAD_VERTICES);
+        GLuint *i = indices + q * QUAD_INDICES;
+        i[0] = v + 0; i[1] = v + 1; i[2] = v + 2;
+        i[3] = v + 1; i[4] = v + 2; i[5] = v + 3;
+    }
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, quad_count * QUAD_INDICES * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    r->quad_ebo_capacity = quad_count;
+    free(indices);
+}
+
+// Makes sure the shared quad index buffer can draw quad_count quads at once.
+static void r_reserve_quad_indices(Renderer *r, size_t quad_count)
+{
+    if(quad_count <= r->quad_ebo_capacity) return;
+
+    size_t capacity = r->quad_ebo_capacity;
+    while(capacity < quad_count) capacity *= 2;
+
+    // The element buffer binding belongs to the VAO.
+    gls_bind_vertex_array(r->vao);
+    r_init_quad_indices(r, capacity);
+}
+
+// Empties the slot table, keeping the current texture in the first slot.
+static void r_reset_texture_slots(Renderer *r)
+{
+    r->slot_count = 1;
+    r->texture_slot = 0;
+
+    if(r->texture_slots && r->texture != 0) {
+        r->slot_textures[r->slot_count] = r->texture;
+        r->texture_slot = r->slot_count++;
+    }
+}
+
+// Sort key index of texture, adding it to the table if it's new. The table
+// must have room for it.
+static uint16_t r_texture_key_add(Renderer *r, GLuint texture)
+{
+    if(texture == 0) return 0;
+
+    for(size_t i = 0; i < r->keyed_textures.count; ++i) {
+        if(r->keyed_textures.items[i] == texture) return i + 1;
+    }
+
+    assert(r->keyed_textures.count < SORT_KEY_TEXTURE_CAP);
+    da_append(&r->keyed_textures, texture);
+    return r->keyed_textures.count;
+}
+
+// Empties the keyed texture table, keeping the current textures in it.
+static void r_reset_texture_keys(Renderer *r)
+{
+    r->keyed_textures.count = 0;
+    r->texture_key = r_texture_key_add(r, r->texture);
+    r->texture_array_key = r_texture_key_add(r, r->texture_array);
+}
+
 void r_init(Renderer *r)
 {
+    if(r->vertex_capacity == 0) r->vertex_capacity = VERTEX_CAP;
+
+    r->vertex_size = vertex_layouts[r->vertex_format].stride;
+    if(r->position_scale == 0.0f) r->position_scale = 1.0f;
+
+    r->cpu_vertices = calloc(r->vertex_capacity, r->vertex_size);
+    assert(r->cpu_vertices != NULL && "Buy more RAM lol");
+
     glGenVertexArrays(1, &r->vao);
-    glBindVertexArray(r->vao);
+    gls_bind_vertex_array(r->vao);
 
     glGenBuffers(1, &r->vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(r->vertices), r->vertices, GL_DYNAMIC_DRAW);
+    gls_bind_buffer(GL_ARRAY_BUFFER, r->vbo);
+
+    glGenBuffers(1, &r->quad_ebo);
+    gls_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, r->quad_ebo);
+    r_init_quad_indices(r, r->vertex_capacity / QUAD_VERTICES);
+
+    if(r->streaming) {
+        r_init_streaming_buffers(r);
+    } else {
+        // Seed the GPU copy with the CPU one so the dirty tracking starts out in sync.
+        glBufferData(GL_ARRAY_BUFFER, r->vertex_capacity * r->vertex_size, r->cpu_vertices, GL_DYNAMIC_DRAW);
+        r->vertices = r->cpu_vertices;
+    }
+
+    r_vertex_attrib_pointers(r->vertex_format);
+
+    glGenVertexArrays(1, &r->instance_vao);
+    gls_bind_vertex_array(r->instance_vao);
+
+    glGenBuffers(1, &r->instance_vbo);
+    gls_bind_buffer(GL_ARRAY_BUFFER, r->instance_vbo);
 
-    glGenBuffers(1, &r->ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(r->indices), r->indices, GL_DYNAMIC_DRAW);
+    for(Instance_Attrib a = 0; a < IA_COUNT; ++a) {
+        glEnableVertexAttribArray(a);
+        glVertexAttribDivisor(a, 1);
+    }
+    r_instance_attrib_pointers(0);
+
+    gpu_allocator_init(&r->mesh_allocator, r->vertex_size, MESH_POOL_ORDER, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(VA_POS, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, pos));
-    glEnableVertexAttribArray(VA_POS);
+    GLint texture_units = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &texture_units);
+    r->texture_slot_cap = texture_units < R_TEXTURE_SLOTS ? (size_t) texture_units : R_TEXTURE_SLOTS;
+    r_reset_texture_slots(r);
 
-    glVertexAttribPointer(VA_UV, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, uv));
-    glEnableVertexAttribArray(VA_UV);
+    for(size_t i = 0; i < 4; ++i) r->frame.view[i * 4 + i] = 1.0f;
+    glGenBuffers(1, &r->frame_ubo);
+    gls_bind_buffer(GL_UNIFORM_BUFFER, r->frame_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(r->frame), &r->frame, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, R_FRAME_BINDING, r->frame_ubo);
 
-    glVertexAttribPointer(VA_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, color));
-    glEnableVertexAttribArray(VA_COLOR);
+    gls_bind_vertex_array(r->vao);
+    gls_bind_buffer(GL_ARRAY_BUFFER, r->vbo);
 }
 
 void r_deallocate(Renderer *r)
 {
-    glDeleteVertexArrays(1, &r->vao);
-    glDeleteBuffers(1, &r->vbo);
-    glDeleteBuffers(1, &r->ebo);
+    for(size_t i = 0; i < R_FRAME_REGIONS; ++i) {
+        if(r->fences[i]) glDeleteSync(r->fences[i]);
+        r->fences[i] = NULL;
+    }
+
+    if(r->persistent) {
+        gls_bind_buffer(GL_ARRAY_BUFFER, r->vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        r->mapped_vertices = NULL;
+    }
+
+    gls_delete_vertex_arrays(1, &r->vao);
+    gls_delete_buffers(1, &r->vbo);
+    gls_delete_buffers(1, &r->quad_ebo);
+
+    gls_delete_vertex_arrays(1, &r->instance_vao);
+    gls_delete_buffers(1, &r->instance_vbo);
+    free(r->instances.items);
+    r->instances = (Quad_Instances){0};
+
+    gls_delete_buffers(1, &r->frame_ubo);
+    for(size_t i = 0; i < SHADER_VARIANT_COUNT; ++i) {
+        Shader_Variant *variant = &r->variants[i];
+        gls_delete_program(variant->program);
+        program_reflection_deallocate(&variant->reflection);
+        file_paths_free(&variant->files);
+        *variant = (Shader_Variant){0};
+    }
+
+    free(r->cpu_vertices);
+    r->cpu_vertices = NULL;
 
-    for(Shader_Program p = 0; p < PROGRAM_COUNT; ++p) {
-        glDeleteProgram(r->programs[p]);
+    for(size_t i = 0; i < r->mesh_allocator.pools.count; ++i) {
+        GPU_Pool *pool = &r->mesh_allocator.pools.items[i];
+        if(pool->vao) gls_delete_vertex_arrays(1, &pool->vao);
     }
+    gpu_allocator_deallocate(&r->mesh_allocator);
+    free(r->meshes.items);
+    r->meshes = (Meshes){0};
+
+    free(r->commands.items);
+    free(r->sort_scratch.items);
+    r->commands = (Draw_Commands){0};
+    r->sort_scratch = (Draw_Commands){0};
+
+    free(r->keyed_textures.items);
+    r->keyed_textures = (Keyed_Textures){0};
+}
+
+Renderer *r_create(Renderer_Config config)
+{
+    Renderer *r = calloc(1, sizeof(Renderer));
+    assert(r != NULL && "Buy more RAM lol");
+
+    r->streaming = config.streaming;
+    r->growable = config.growable;
+    r->instanced = config.instanced;
+    r->texture_slots = config.texture_slots;
+    r->vertex_format = config.vertex_format;
+    r_init(r);
+
+    return r;
+}
+
+void r_destroy(Renderer *r)
+{
+    r_deallocate(r);
+    free(r);
 }
 
 void reload_render_conf(void)
@@ -214,84 +988,1057 @@ void reload_render_conf(void)
     slurp_file(render_conf);
 }
 
-bool r_reload_shaders(Renderer *r)
+// Reflects a freshly loaded variant, caching the locations set while
+// drawing and setting the uniforms that never change.
+static void r_init_variant(Shader_Variant *variant)
 {
-    for(Shader_Program p = 0; p < PROGRAM_COUNT; ++p) {
-        glDeleteProgram(r->programs[p]);
+    GLuint program = variant->program;
+    program_reflect(program, &variant->reflection);
+
+    const Program_Uniform *position_scale = program_uniform(&variant->reflection, "position_scale");
+    variant->position_scale = position_scale ? position_scale->location : -1;
+
+    // Block bindings aren't kept in cached program binaries, so they're set on every load.
+    if(program_bind_block(program, &variant->reflection, "Frame", R_FRAME_BINDING)) {
+        const Program_Block *frame = program_block(&variant->reflection, "Frame");
+        if((size_t) frame->data_size > sizeof(Frame_Uniforms)) {
+            LOG_WARN("Frame block is %d bytes, but Frame_Uniforms is only %zu", frame->data_size, sizeof(Frame_Uniforms));
+        }
+        for(size_t i = 0; i < sizeof(frame_members) / sizeof(frame_members[0]); ++i) {
+            const Program_Uniform *member = program_block_member(frame, frame_members[i].name);
+            if(member != NULL && (size_t) member->offset != frame_members[i].offset) {
+                LOG_WARN("Frame.%s is at byte %d, but Frame_Uniforms has it at %zu",
+                         frame_members[i].name, member->offset, frame_members[i].offset);
+            }
+        }
     }
 
-    if(!load_shader_program(screen_shader_path, basic_fragment_shader_path, &r->programs[PROGRAM_BASIC])) return false;
-    if(!load_shader_program(screen_shader_path, wireframe_shader_path, &r->programs[PROGRAM_WIREFRAME])) return false;
-    if(!load_shader_program(screen_shader_path, texture_shader_path, &r->programs[PROGRAM_TEXTURE])) return false;
+    // Element i of the textures array samples texture unit i.
+    const Program_Uniform *textures = program_sampler(&variant->reflection, "textures");
+    if(textures != NULL) {
+        GLint units[R_TEXTURE_SLOTS];
+        assert(textures->size <= R_TEXTURE_SLOTS);
+        for(GLint i = 0; i < textures->size; ++i) units[i] = i;
 
-    return true;
+        gls_use_program(program);
+        glUniform1iv(textures->location, textures->size, units);
+    }
+}
+
+// Name of a variant for messages, like `sprite[INSTANCED|TEXTURE]`.
+static void shader_variant_name(Shader_Feature features, char *name, size_t size)
+{
+    int n = snprintf(name, size, "sprite[");
+    const char *separator = "";
+    for(size_t i = 0; i < SHADER_FEATURE_COUNT; ++i) {
+        if(!(features & (1 << i))) continue;
+        n += snprintf(name + n, size - n, "%s%s", separator, shader_feature_names[i]);
+        separator = "|";
+    }
+    snprintf(name + n, size - n, "]");
+}
+
+static char *preprocess_stage(const char *file_path, Shader_Feature features, File_Paths *files)
+{
+    const char *defines[SHADER_FEATURE_COUNT];
+    size_t define_count = 0;
+    for(size_t i = 0; i < SHADER_FEATURE_COUNT; ++i) {
+        if(features & (1 << i)) defines[define_count++] = shader_feature_names[i];
+    }
+    return shader_preprocess(file_path, defines, define_count, files);
+}
+
+// Builds the variants all at once. A variant is only replaced once its new
+// version linked; one that fails keeps drawing with the old version.
+static bool r_build_variants(Renderer *r, const Shader_Feature *features, size_t count)
+{
+    bool result = true;
+
+    char names[SHADER_VARIANT_COUNT][64];
+    char *sources[SHADER_VARIANT_COUNT][2] = {0};
+    File_Paths files[SHADER_VARIANT_COUNT] = {0};
+    GLuint loaded[SHADER_VARIANT_COUNT] = {0};
+    Program_Build builds[SHADER_VARIANT_COUNT];
+    size_t build_count = 0;
+
+    assert(count <= SHADER_VARIANT_COUNT);
+    for(size_t i = 0; i < count; ++i) {
+        Shader_Feature f = features[i];
+        shader_variant_name(f, names[i], sizeof(names[i]));
+
+        // Files are recorded even when preprocessing fails, so fixing the
+        // broken one triggers a reload.
+        sources[i][0] = preprocess_stage(sprite_vertex_shader_path, f & SHADER_VERTEX_FEATURES, &files[i]);
+        sources[i][1] = preprocess_stage(sprite_fragment_shader_path, f & ~SHADER_VERTEX_FEATURES, &files[i]);
+        if(sources[i][0] == NULL || sources[i][1] == NULL) {
+            LOG_ERROR("failed to preprocess %s", names[i]);
+            result = false;
+            continue;
+        }
+
+        builds[build_count++] = (Program_Build){names[i], sources[i][0], sources[i][1], &loaded[i]};
+    }
+
+    if(build_count > 0 && !load_shader_programs(builds, build_count)) result = false;
+
+    for(size_t i = 0; i < count; ++i) {
+        Shader_Variant *variant = &r->variants[features[i]];
+        if(loaded[i] != 0) {
+            gls_delete_program(variant->program);
+            variant->program = loaded[i];
+            r_init_variant(variant);
+        }
+        variant->failed = variant->program == 0;
+
+        file_paths_free(&variant->files);
+        variant->files = files[i];
+        free(sources[i][0]);
+        free(sources[i][1]);
+    }
+
+    return result;
+}
+
+// The variant with these features, building it on first use. Returns a
+// variant with program 0 if it never built.
+static Shader_Variant *r_variant(Renderer *r, Shader_Feature features)
+{
+    Shader_Variant *variant = &r->variants[features];
+    if(variant->program == 0 && !variant->failed) r_build_variants(r, &features, 1);
+    return variant;
+}
+
+static bool paths_contain(const File_Paths *paths, const char *path)
+{
+    for(size_t i = 0; i < paths->count; ++i) {
+        if(strcmp(paths->items[i], path) == 0) return true;
+    }
+    return false;
+}
+
+static bool paths_intersect(const File_Paths *a, const File_Paths *b)
+{
+    for(size_t i = 0; i < a->count; ++i) {
+        if(paths_contain(b, a->items[i])) return true;
+    }
+    return false;
+}
+
+// Rebuilds the variants built so far that read any of the changed files,
+// or all of them when changed is NULL.
+static bool r_rebuild_variants(Renderer *r, const File_Paths *changed)
+{
+    Shader_Feature features[SHADER_VARIANT_COUNT];
+    size_t count = 0;
+    for(size_t i = 0; i < SHADER_VARIANT_COUNT; ++i) {
+        Shader_Variant *variant = &r->variants[i];
+        if(variant->program == 0 && !variant->failed) continue;
+        if(changed != NULL && !paths_intersect(&variant->files, changed)) continue;
+
+        features[count++] = (Shader_Feature) i;
+    }
+    if(count == 0) return true;
+
+    bool ok = r_build_variants(r, features, count);
+    if(changed != NULL) LOG_INFO("Rebuilt %zu shader variants using changed files", count);
+
+    return ok;
+}
+
+bool r_reload_shaders(Renderer *r)
+{
+    return r_rebuild_variants(r, NULL);
+}
+
+// Only rebuilds the variants that use one of the changed files.
+bool r_reload_changed_shaders(Renderer *r, const File_Paths *changed)
+{
+    return r_rebuild_variants(r, changed);
 }
 
 void r_toggle_wireframe(void)
 {
-    GLint *polygon_mode = malloc(sizeof(GLint));  // avoid stack smashing error
-    glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
-    switch(*polygon_mode) {
-        case GL_FILL: {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    // The mode is GL_NONE until first set, and GL starts out filling.
+    switch(gls_get_polygon_mode()) {
+        case GL_LINE: {
+            gls_polygon_mode(GL_FILL);
         } break;
 
-        case GL_LINE:
+        case GL_FILL:
         default: {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            gls_polygon_mode(GL_LINE);
         } break;
+    }
+}
+
+void dirty_spans_mark(Dirty_Spans *spans, size_t index)
+{
+    // Geometry is mostly emitted in order, so try the last span first.
+    for(size_t i = spans->count; i > 0; --i) {
+        Dirty_Span *span = &spans->items[i - 1];
+        if(index + DIRTY_SPAN_MERGE_GAP >= span->begin && index <= span->end + DIRTY_SPAN_MERGE_GAP) {
+            if(index < span->begin) span->begin = index;
+            if(index + 1 > span->end) span->end = index + 1;
+            return;
+        }
+    }
+
+    if(spans->count >= DIRTY_SPAN_CAP) {
+        // Out of spans: fold everything into a single range.
+        Dirty_Span all = spans->items[0];
+        for(size_t i = 1; i < spans->count; ++i) {
+            if(spans->items[i].begin < all.begin) all.begin = spans->items[i].begin;
+            if(spans->items[i].end > all.end) all.end = spans->items[i].end;
+        }
+        if(index < all.begin) all.begin = index;
+        if(index + 1 > all.end) all.end = index + 1;
 
+        spans->items[0] = all;
+        spans->count = 1;
+        return;
     }
-    free(polygon_mode);
+
+    spans->items[spans->count++] = (Dirty_Span){index, index + 1};
+}
+
+static void r_upload_dirty(Renderer *r, GLenum target, Dirty_Spans *spans,
+                           const void *data, size_t element_size)
+{
+    for(size_t i = 0; i < spans->count; ++i) {
+        Dirty_Span span = spans->items[i];
+        size_t size = (span.end - span.begin) * element_size;
+
+        glBufferSubData(target,
+                        span.begin * element_size,
+                        size,
+                        (const char *) data + span.begin * element_size);
+
+        r->stats.bytes_uploaded += size;
+        r->stats.upload_calls += 1;
+    }
+    spans->count = 0;
 }
 
+static void r_wait_fence(GLsync *fence)
+{
+    if(*fence == NULL) return;
+
+    GLenum status = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while(status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+    if(status == GL_WAIT_FAILED) LOG_ERROR("failed to wait for frame fence");
+
+    glDeleteSync(*fence);
+    *fence = NULL;
+}
+
+// Moves on to the next frame region, blocking only if the GPU is still
+// reading it.
+static void r_acquire_region(Renderer *r)
+{
+    r->region = (r->region + 1) % R_FRAME_REGIONS;
+    r_wait_fence(&r->fences[r->region]);
+
+    if(r->persistent) {
+        r->vertices = r->mapped_vertices + r->region * r->vertex_capacity * r->vertex_size;
+        return;
+    }
+
+    // The fence already guarantees the region is idle, so skip the driver's sync.
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+
+    r->vertices = glMapBufferRange(GL_ARRAY_BUFFER,
+                                   r->region * r->vertex_capacity * r->vertex_size,
+                                   r->vertex_capacity * r->vertex_size,
+                                   flags);
+
+    if(r->vertices == NULL) {
+        LOG_ERROR("failed to map frame region %zu", r->region);
+        r->streaming = false;
+        r->vertices = r->cpu_vertices;
+
+        // The GPU copy was never seeded, so the first sync uploads everything.
+        r->dirty_vertices = (Dirty_Spans){.items = {{0, r->vertex_capacity}}, .count = 1};
+    }
+}
+
+void r_begin_frame(Renderer *r)
+{
+    r->vertex_count = 0;
+    r->instances.count = 0;
+    r->stats = (Renderer_Stats){0};
+}
+
+void r_sync_buffers(Renderer *r)
+{
+    if(r->streaming) {
+        // Persistent coherent mappings need no flush at all.
+        if(!r->persistent) glUnmapBuffer(GL_ARRAY_BUFFER);
+        r->stats.bytes_uploaded += r->vertex_count * r->vertex_size;
+        return;
+    }
+
+    r_upload_dirty(r, GL_ARRAY_BUFFER, &r->dirty_vertices, r->vertices, r->vertex_size);
+}
+
+// Maps a float onto a uint32_t with the same ordering.
+static uint32_t sortable_float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+static uint64_t r_sort_key(const Renderer *r, bool instanced, uint16_t texture)
+{
+    uint64_t program = r->program | (instanced ? SORT_KEY_INSTANCED : 0);
+
+    return ((uint64_t) r->layer << SORT_KEY_LAYER_SHIFT)
+         | (program             << SORT_KEY_PROGRAM_SHIFT)
+         | ((uint64_t) texture  << SORT_KEY_TEXTURE_SHIFT)
+         | (uint64_t) sortable_float_bits(r->depth);
+}
+
+// Texture a command of the current state binds through its sort key.
+// Slotted quads pick theirs by slot, unless they sample an array texture.
+static uint16_t r_keyed_texture(const Renderer *r, bool slotted)
+{
+    if(r->program == PROGRAM_TEXTURE_ARRAY) return r->texture_array_key;
+    return slotted ? 0 : r->texture_key;
+}
+
+void r_set_layer(Renderer *r, uint8_t layer)          { r->layer = layer; }
+void r_set_program(Renderer *r, Shader_Program program) { r->program = program; }
+void r_set_depth(Renderer *r, float depth)            { r->depth = depth; }
+void r_set_texture_layer(Renderer *r, uint16_t layer) { r->texture_layer = layer; }
+
+void r_set_time(Renderer *r, double seconds)
+{
+    if(r->frame.time == (float) seconds) return;
+    r->frame.time = (float) seconds;
+    r->frame_dirty = true;
+}
+
+void r_set_resolution(Renderer *r, int width, int height)
+{
+    if(r->frame.resolution[0] == (float) width && r->frame.resolution[1] == (float) height) return;
+    r->frame.resolution[0] = (float) width;
+    r->frame.resolution[1] = (float) height;
+    r->frame_dirty = true;
+}
+
+// Column-major, applied to every position after position_scale.
+void r_set_view(Renderer *r, const float view[16])
+{
+    if(memcmp(r->frame.view, view, sizeof(r->frame.view)) == 0) return;
+    memcpy(r->frame.view, view, sizeof(r->frame.view));
+    r->frame_dirty = true;
+}
+
+// Appends a range of the current batch's indices (or instances) to the
+// command queue, extending the previous command when it has the same key.
+static void r_push_command(Renderer *r, bool instanced, size_t first_index, size_t index_count)
+{
+    uint64_t key = r_sort_key(r, instanced, r_keyed_texture(r, r->texture_slots));
+
+    if(r->commands.count > 0) {
+        Draw_Command *last = &r->commands.items[r->commands.count - 1];
+        if(last->key == key && last->mesh == 0 && last->first_index + last->index_count == first_index) {
+            last->index_count += index_count;
+            return;
+        }
+    }
+
+    Draw_Command command = {key, first_index, index_count, 0};
+    da_append(&r->commands, command);
+}
+
+// Stable LSD radix sort, one byte per pass. Passes where every key has the
+// same byte are skipped, which for typical keys is most of them.
+static void draw_commands_sort(Draw_Commands *commands, Draw_Commands *scratch)
+{
+    size_t count = commands->count;
+    if(count < 2) return;
+
+    if(scratch->capacity < count) {
+        scratch->capacity = commands->capacity;
+        scratch->items = realloc(scratch->items, scratch->capacity * sizeof(Draw_Command));
+        assert(scratch->items != NULL && "Buy more RAM lol");
+    }
+
+    Draw_Command *src = commands->items;
+    Draw_Command *dst = scratch->items;
+
+    for(unsigned shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {0};
+        for(size_t i = 0; i < count; ++i) {
+            offsets[(src[i].key >> shift) & 0xFF] += 1;
+        }
+        if(offsets[(src[0].key >> shift) & 0xFF] == count) continue;
+
+        size_t total = 0;
+        for(size_t b = 0; b < 256; ++b) {
+            size_t n = offsets[b];
+            offsets[b] = total;
+            total += n;
+        }
+
+        for(size_t i = 0; i < count; ++i) {
+            dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+
+        Draw_Command *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if(src != commands->items) {
+        memcpy(commands->items, src, count * sizeof(Draw_Command));
+    }
+}
+
+// Folds neighbouring commands that share state and index ranges into one.
+static void draw_commands_merge(Draw_Commands *commands)
+{
+    if(commands->count < 2) return;
+
+    size_t merged = 0;
+    for(size_t i = 1; i < commands->count; ++i) {
+        Draw_Command *last = &commands->items[merged];
+        Draw_Command *next = &commands->items[i];
+
+        if((last->key & SORT_KEY_STATE_MASK) == (next->key & SORT_KEY_STATE_MASK) &&
+           last->mesh == next->mesh &&
+           last->first_index + last->index_count == next->first_index) {
+            last->index_count += next->index_count;
+        } else {
+            commands->items[++merged] = *next;
+        }
+    }
+    commands->count = merged + 1;
+}
+
+static void r_upload_instances(Renderer *r)
+{
+    if(r->instances.count == 0) return;
+
+    size_t size = r->instances.count * sizeof(Quad_Instance);
+
+    // Orphan the store so the upload never waits on last frame's draws.
+    gls_bind_buffer(GL_ARRAY_BUFFER, r->instance_vbo);
+    if(r->instance_vbo_capacity < r->instances.capacity) {
+        r->instance_vbo_capacity = r->instances.capacity;
+    }
+    glBufferData(GL_ARRAY_BUFFER, r->instance_vbo_capacity * sizeof(Quad_Instance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, r->instances.items);
+    gls_bind_buffer(GL_ARRAY_BUFFER, r->vbo);
+
+    r->stats.bytes_uploaded += size;
+    r->stats.upload_calls += 1;
+}
+
+// Points the VAO of every mesh pool whose buffer was created or replaced
+// (by growth or defragmentation) at the new buffer.
+static void r_sync_mesh_pools(Renderer *r)
+{
+    for(size_t i = 0; i < r->mesh_allocator.pools.count; ++i) {
+        GPU_Pool *pool = &r->mesh_allocator.pools.items[i];
+        if(!pool->dirty) continue;
+
+        if(pool->buffer == 0) {
+            if(pool->vao) gls_delete_vertex_arrays(1, &pool->vao);
+            pool->vao = 0;
+        } else {
+            if(pool->vao == 0) glGenVertexArrays(1, &pool->vao);
+            gls_bind_vertex_array(pool->vao);
+            gls_bind_buffer(GL_ARRAY_BUFFER, pool->buffer);
+            r_vertex_attrib_pointers(r->vertex_format);
+            gls_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, r->quad_ebo);
+        }
+        pool->dirty = false;
+    }
+
+    gls_bind_vertex_array(r->vao);
+    gls_bind_buffer(GL_ARRAY_BUFFER, r->vbo);
+}
+
+static const GPU_Block *r_mesh_block(const Renderer *r, size_t mesh)
+{
+    return gpu_block(&r->mesh_allocator, r->meshes.items[mesh].allocation);
+}
+
+// Scale the positions of a command are relative to.
+static float r_command_position_scale(const Renderer *r, const Draw_Command *cmd)
+{
+    if(r->vertex_format != VERTEX_FORMAT_QUANTIZED) return 1.0f;
+    return cmd->mesh ? r->meshes.items[cmd->mesh - 1].position_scale : r->position_scale;
+}
+
+// Draws the mesh command at *i together with the following ones that share
+// its state, pool and position scale, advancing *i past them.
+static void r_draw_meshes(Renderer *r, size_t *i)
+{
+    GLsizei counts[MESH_MULTI_DRAW_CAP];
+    void *indices[MESH_MULTI_DRAW_CAP];
+    GLint base_vertices[MESH_MULTI_DRAW_CAP];
+    GLsizei draws = 0;
+
+    const Draw_Command *first = &r->commands.items[*i];
+    size_t pool = r_mesh_block(r, first->mesh - 1)->pool;
+    float position_scale = r_command_position_scale(r, first);
+
+    for(;;) {
+        const Draw_Command *cmd = &r->commands.items[*i];
+        counts[draws] = cmd->index_count;
+        indices[draws] = (void *) (cmd->first_index * sizeof(GLuint));
+        base_vertices[draws] = r_mesh_block(r, cmd->mesh - 1)->offset;
+        draws += 1;
+
+        if(draws == MESH_MULTI_DRAW_CAP || *i + 1 >= r->commands.count) break;
+        const Draw_Command *next = &r->commands.items[*i + 1];
+        if(next->mesh == 0) break;
+        if((next->key & SORT_KEY_STATE_MASK) != (first->key & SORT_KEY_STATE_MASK)) break;
+        if(r_mesh_block(r, next->mesh - 1)->pool != pool) break;
+        if(r_command_position_scale(r, next) != position_scale) break;
+        *i += 1;
+    }
+
+    if(draws == 1) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, counts[0], GL_UNSIGNED_INT, indices[0], base_vertices[0]);
+    } else {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, indices, draws, base_vertices);
+    }
+}
+
+static void r_execute_commands(Renderer *r)
+{
+    size_t region = r->streaming ? r->region : 0;
+    GLint vertex_base = region * r->vertex_capacity;
+
+    r_sync_mesh_pools(r);
+
+    // Quads take their alpha from the color and the texture. Through the
+    // cache this only reaches GL the first time.
+    gls_blend(true);
+    gls_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    for(size_t i = 1; i < r->slot_count; ++i) {
+        gls_bind_texture(i, GL_TEXTURE_2D, r->slot_textures[i]);
+    }
+
+    r->stats.commands += r->commands.count;
+    draw_commands_sort(&r->commands, &r->sort_scratch);
+    draw_commands_merge(&r->commands);
+
+    int program = -1;
+    GLint position_scale_location = -1;
+    float position_scale = 0.0f;  // unknown for the program in use
+    GLuint texture = 0;
+    GLuint vao = r->vao;
+
+    for(size_t i = 0; i < r->commands.count; ++i) {
+        Draw_Command *cmd = &r->commands.items[i];
+        int cmd_program = (cmd->key >> SORT_KEY_PROGRAM_SHIFT) & 0xFF;
+        uint16_t texture_key = (cmd->key >> SORT_KEY_TEXTURE_SHIFT) & 0xFFFF;
+        GLuint cmd_texture = texture_key ? r->keyed_textures.items[texture_key - 1] : 0;
+        bool instanced = cmd_program & SORT_KEY_INSTANCED;
+
+        if(cmd_program != program) {
+            Shader_Feature features = program_features[cmd_program & ~SORT_KEY_INSTANCED];
+            if(instanced) features |= SHADER_INSTANCED;
+
+            Shader_Variant *variant = r_variant(r, features);
+            gls_use_program(variant->program);
+            position_scale_location = variant->position_scale;
+            position_scale = 0.0f;
+            program = cmd_program;
+            r->stats.state_changes += 1;
+        }
+
+        // The batch and every mesh may each be quantized with another scale.
+        float cmd_position_scale = r_command_position_scale(r, cmd);
+        if(position_scale_location >= 0 && cmd_position_scale != position_scale) {
+            glUniform1f(position_scale_location, cmd_position_scale);
+            position_scale = cmd_position_scale;
+        }
+
+        // Texture 0 means the command doesn't sample, so keep whatever is bound.
+        if(cmd_texture != 0 && cmd_texture != texture) {
+            bool array = (cmd_program & ~SORT_KEY_INSTANCED) == PROGRAM_TEXTURE_ARRAY;
+            gls_bind_texture(0, array ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, cmd_texture);
+            texture = cmd_texture;
+            r->stats.state_changes += 1;
+        }
+
+        GLuint cmd_vao = instanced ? r->instance_vao : r->vao;
+        if(cmd->mesh) {
+            cmd_vao = r->mesh_allocator.pools.items[r_mesh_block(r, cmd->mesh - 1)->pool].vao;
+        }
+        if(cmd_vao != vao) {
+            gls_bind_vertex_array(cmd_vao);
+            vao = cmd_vao;
+            r->stats.state_changes += 1;
+        }
+
+        if(instanced) {
+            if(GLEW_ARB_base_instance) {
+                glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4,
+                                                  cmd->index_count, cmd->first_index);
+            } else {
+                gls_bind_buffer(GL_ARRAY_BUFFER, r->instance_vbo);
+                r_instance_attrib_pointers(cmd->first_index);
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, cmd->index_count);
+            }
+        } else if(cmd->mesh) {
+            r_draw_meshes(r, &i);
+        } else {
+            glDrawElementsBaseVertex(GL_TRIANGLES,
+                                     cmd->index_count,
+                                     GL_UNSIGNED_INT,
+                                     (void *) (cmd->first_index * sizeof(GLuint)),
+                                     vertex_base);
+        }
+        r->stats.draw_calls += 1;
+    }
+
+    // The streaming and dirty upload paths expect the batch buffers bound.
+    gls_bind_vertex_array(r->vao);
+    gls_bind_buffer(GL_ARRAY_BUFFER, r->vbo);
+
+    r->commands.count = 0;
+}
+
+// Uploads the Frame block if a frame constant changed since the last flush.
+static void r_upload_frame_uniforms(Renderer *r)
+{
+    if(!r->frame_dirty) return;
+
+    gls_bind_buffer(GL_UNIFORM_BUFFER, r->frame_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(r->frame), &r->frame);
+    r->frame_dirty = false;
+    r->stats.bytes_uploaded += sizeof(r->frame);
+}
+
+// Uploads the pending batch, draws its command queue in sort-key order,
+// then starts a new batch.
+void r_flush(Renderer *r)
+{
+    if(r->vertices != NULL) r_sync_buffers(r);
+    r_upload_instances(r);
+
+    if(r->commands.count > 0) {
+        r->stats.vertices += r->vertex_count;
+        r->stats.indices += r->vertex_count / QUAD_VERTICES * QUAD_INDICES;
+        r->stats.instances += r->instances.count;
+
+        r_upload_frame_uniforms(r);
+        r_execute_commands(r);
+
+        if(r->streaming && r->vertices != NULL) {
+            r->fences[r->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+    }
+
+    r->instances.count = 0;
+
+    if(r->streaming) r->vertices = NULL;
+    r->vertex_count = 0;
+
+    r_reset_texture_slots(r);
+    r_reset_texture_keys(r);
+}
+
+// Sort key index of texture. A full table is flushed to make room.
+static uint16_t r_texture_key(Renderer *r, GLuint texture)
+{
+    if(texture != 0 && r->keyed_textures.count == SORT_KEY_TEXTURE_CAP) {
+        for(size_t i = 0; i < r->keyed_textures.count; ++i) {
+            if(r->keyed_textures.items[i] == texture) return i + 1;
+        }
+        // Flushing keeps the current textures, and nothing else.
+        r_flush(r);
+    }
+    return r_texture_key_add(r, texture);
+}
+
+void r_set_texture_array(Renderer *r, GLuint texture)
+{
+    r->texture_array = texture;
+    r->texture_array_key = r_texture_key(r, texture);
+}
+
+void r_set_texture(Renderer *r, GLuint texture)
+{
+    r->texture = texture;
+    r->texture_key = r_texture_key(r, texture);
+    if(!r->texture_slots) return;
+
+    if(texture == 0) {
+        r->texture_slot = 0;
+        return;
+    }
+
+    for(size_t i = 1; i < r->slot_count; ++i) {
+        if(r->slot_textures[i] == texture) {
+            r->texture_slot = i;
+            return;
+        }
+    }
+
+    if(r->slot_count >= r->texture_slot_cap) {
+        // Flushing resets the table, leaving the new texture in its first slot.
+        r->stats.slot_flushes += 1;
+        r_flush(r);
+        return;
+    }
+
+    r->slot_textures[r->slot_count] = texture;
+    r->texture_slot = r->slot_count++;
+}
+
+static void r_grow(Renderer *r, size_t vertex_count)
+{
+    size_t vertex_capacity = r->vertex_capacity;
+    while(vertex_capacity < vertex_count) vertex_capacity *= 2;
+
+    r->cpu_vertices = realloc(r->cpu_vertices, vertex_capacity * r->vertex_size);
+    assert(r->cpu_vertices != NULL && "Buy more RAM lol");
+    memset(r->cpu_vertices + r->vertex_capacity * r->vertex_size, 0,
+           (vertex_capacity - r->vertex_capacity) * r->vertex_size);
+    r->vertex_capacity = vertex_capacity;
+    r->vertices = r->cpu_vertices;
+
+    // Respecifying the store uploads everything, dirty or not.
+    glBufferData(GL_ARRAY_BUFFER, vertex_capacity * r->vertex_size, r->cpu_vertices, GL_DYNAMIC_DRAW);
+    r->dirty_vertices.count = 0;
+    r->stats.bytes_uploaded += vertex_capacity * r->vertex_size;
+    r->stats.upload_calls += 1;
+
+    r_reserve_quad_indices(r, vertex_capacity / QUAD_VERTICES);
+}
+
+// Makes room for a quad in the current batch, flushing or growing the
+// batch when it is full.
+static void r_reserve_quad(Renderer *r)
+{
+    if(r->streaming && r->vertices == NULL) r_acquire_region(r);
+
+    if(r->vertex_count + QUAD_VERTICES <= r->vertex_capacity) return;
+
+    if(r->growable && !r->streaming) {
+        r_grow(r, r->vertex_count + QUAD_VERTICES);
+        return;
+    }
+
+    r_flush(r);
+    if(r->streaming) r_acquire_region(r);
+}
+
+// position_scale only matters to VERTEX_FORMAT_QUANTIZED.
+static void r_encode_vertex(const Renderer *r, Vertex v, float position_scale, unsigned char *out)
+{
+    switch(r->vertex_format) {
+        case VERTEX_FORMAT_F32: {
+            memcpy(out, &v, sizeof(v));
+        } break;
+
+        case VERTEX_FORMAT_PACKED: {
+            Packed_Vertex p = {
+                .pos = v.pos,
+                .uv = {pack_unorm16(v.uv.x), pack_unorm16(v.uv.y)},
+                .color = {pack_unorm8(v.color.x), pack_unorm8(v.color.y), pack_unorm8(v.color.z), pack_unorm8(v.color.w)},
+                .slot = (uint8_t) v.slot,
+                .layer = v.layer,
+            };
+            memcpy(out, &p, sizeof(p));
+        } break;
+
+        case VERTEX_FORMAT_QUANTIZED: {
+            Quantized_Vertex q = {
+                .pos = {pack_snorm16(v.pos.x / position_scale), pack_snorm16(v.pos.y / position_scale)},
+                .uv = {pack_unorm16(v.uv.x), pack_unorm16(v.uv.y)},
+                .color = {pack_unorm8(v.color.x), pack_unorm8(v.color.y), pack_unorm8(v.color.z), pack_unorm8(v.color.w)},
+                .slot = (uint8_t) v.slot,
+                .layer = v.layer,
+            };
+            memcpy(out, &q, sizeof(q));
+        } break;
+
+        default: assert(0 && "unreachable");
+    }
+}
+
+// Quantized positions cover [-scale, scale]. Larger scales trade precision
+// for range; the whole batch shares one scale. Meshes keep the scale they
+// were created with.
+void r_set_position_scale(Renderer *r, float scale)
+{
+    if(scale == r->position_scale) return;
+    if(r->vertex_count > 0) r_flush(r);
+    r->position_scale = scale;
+}
+
+// Writes into space set aside by r_reserve_quad, so vertices always come
+// in groups of QUAD_VERTICES.
 void r_vertex(Renderer *r, Vertex v)
 {
-    assert(r->vertex_count < VERTEX_CAP);
-    r->vertices[r->vertex_count++] = v;
+    assert(r->vertex_count < r->vertex_capacity);
+    size_t i = r->vertex_count++;
+    unsigned char *dst = r->vertices + i * r->vertex_size;
+
+    if(r->streaming) {
+        // Never read back from mapped (write-combined) memory.
+        r_encode_vertex(r, v, r->position_scale, dst);
+        return;
+    }
+
+    unsigned char encoded[sizeof(Vertex)];
+    r_encode_vertex(r, v, r->position_scale, encoded);
+
+    if(memcmp(dst, encoded, r->vertex_size) != 0) {
+        memcpy(dst, encoded, r->vertex_size);
+        dirty_spans_mark(&r->dirty_vertices, i);
+    }
 }
 
-void r_quad_pp(Renderer *r, V2f p1, V2f p2, V4f color)
+static void r_instance(Renderer *r, V2f center, V2f half_size, float rotation, V4f uv_rect, V4f color)
+{
+    Quad_Instance instance = {
+        .center = center,
+        .half_size = half_size,
+        .color = {pack_unorm8(color.x), pack_unorm8(color.y), pack_unorm8(color.z), pack_unorm8(color.w)},
+        .uv_rect = {pack_unorm16(uv_rect.x), pack_unorm16(uv_rect.y), pack_unorm16(uv_rect.z), pack_unorm16(uv_rect.w)},
+        .rotation = rotation,
+        .slot = r->texture_slot,
+        .layer = r->texture_layer,
+    };
+
+    size_t first_instance = r->instances.count;
+    da_append(&r->instances, instance);
+    r_push_command(r, true, first_instance, 1);
+}
+
+// Emits a quad from its corners: bottom left, bottom right, top left, top right.
+static void r_quad_corners(Renderer *r, V2f a, V2f b, V2f c, V2f d, V4f uv_rect, V4f color)
+{
+    r_reserve_quad(r);
+    size_t first_index = r->vertex_count / QUAD_VERTICES * QUAD_INDICES;
+
+    r_vertex(r, (Vertex){a, v2f(uv_rect.x, uv_rect.y), color, r->texture_slot, r->texture_layer});
+    r_vertex(r, (Vertex){b, v2f(uv_rect.z, uv_rect.y), color, r->texture_slot, r->texture_layer});
+    r_vertex(r, (Vertex){c, v2f(uv_rect.x, uv_rect.w), color, r->texture_slot, r->texture_layer});
+    r_vertex(r, (Vertex){d, v2f(uv_rect.z, uv_rect.w), color, r->texture_slot, r->texture_layer});
+
+    r_push_command(r, false, first_index, QUAD_INDICES);
+}
+
+// Quad around center, rotated counter-clockwise by rotation radians and
+// textured with uv_rect (u0, v0, u1, v1).
+void r_sprite(Renderer *r, V2f center, V2f half_size, float rotation, V4f uv_rect, V4f color)
+{
+    if(r->instanced) {
+        r_instance(r, center, half_size, rotation, uv_rect, color);
+        return;
+    }
+
+    V2f x = v2f(half_size.x, 0.0f);
+    V2f y = v2f(0.0f, half_size.y);
+    if(rotation != 0.0f) {
+        float s = sinf(rotation);
+        float c = cosf(rotation);
+        x = v2f(c * half_size.x, s * half_size.x);
+        y = v2f(-s * half_size.y, c * half_size.y);
+    }
+
+    V2f bottom = v2f_sub(center, y);
+    V2f top = v2f_sum(center, y);
+
+    r_quad_corners(r,
+                   v2f_sub(bottom, x), v2f_sum(bottom, x),
+                   v2f_sub(top, x), v2f_sum(top, x),
+                   uv_rect, color);
+}
+
+// Quad from p1 to p2 textured with uv_rect (u0, v0, u1, v1), e.g. an
+// atlas_uv_rect() lookup.
+void r_quad_pp_uv(Renderer *r, V2f p1, V2f p2, V4f uv_rect, V4f color)
 {
     V2f a = p1;               // Bottom Left
     V2f b = v2f(p2.x, p1.y);  // Bottom Right
     V2f c = v2f(p1.x, p2.y);  // Top Left
     V2f d = p2;               // Top Right
 
-    GLuint index_start = (GLuint) r->vertex_count;
-
-    r_vertex(r, (Vertex){a, v2f(0.0f, 0.0f), color});
-    r_vertex(r, (Vertex){b, v2f(1.0f, 0.0f), color});
-    r_vertex(r, (Vertex){c, v2f(0.0f, 1.0f), color});
-    r_vertex(r, (Vertex){d, v2f(1.0f, 1.0f), color});
+    if(r->instanced) {
+        V2f center = v2f_mul(v2f_sum(p1, p2), v2ff(0.5f));
+        V2f half_size = v2f_mul(v2f_sub(p2, p1), v2ff(0.5f));
+        r_instance(r, center, half_size, 0.0f, uv_rect, color);
+        return;
+    }
 
-    r->indices[r->index_count++] = index_start + 0;
-    r->indices[r->index_count++] = index_start + 1;
-    r->indices[r->index_count++] = index_start + 2;
+    r_quad_corners(r, a, b, c, d, uv_rect, color);
+}
 
-    r->indices[r->index_count++] = index_start + 1;
-    r->indices[r->index_count++] = index_start + 2;
-    r->indices[r->index_count++] = index_start + 3;
+void r_quad_pp(Renderer *r, V2f p1, V2f p2, V4f color)
+{
+    r_quad_pp_uv(r, p1, p2, v4f(0.0f, 0.0f, 1.0f, 1.0f), color);
 }
 
 void r_quad_cr(Renderer *r, V2f center, V2f radius, V4f color)
 {
-    V2f p1 = v2f_sub(center, radius);
-    V2f p2 = v2f_sum(center, radius);
-    r_quad_pp(r, p1, p2, color);
+    r_sprite(r, center, radius, 0.0f, v4f(0.0f, 0.0f, 1.0f, 1.0f), color);
 }
 
-void r_sync_buffers(Renderer *r)
+/* Retained Meshes */
+
+// Moves the mesh to a new block of quad_capacity quads, keeping its contents.
+static void r_mesh_reallocate(Renderer *r, Mesh *mesh, size_t quad_capacity)
+{
+    GPU_Allocation allocation = gpu_alloc(&r->mesh_allocator, quad_capacity * QUAD_VERTICES);
+    assert(allocation != GPU_ALLOCATION_NONE);
+
+    if(mesh->allocation != GPU_ALLOCATION_NONE) {
+        // Looked up after gpu_alloc(), which may move both arrays.
+        const GPU_Block *src = gpu_block(&r->mesh_allocator, mesh->allocation);
+        const GPU_Block *dst = gpu_block(&r->mesh_allocator, allocation);
+
+        gls_bind_buffer(GL_COPY_READ_BUFFER, r->mesh_allocator.pools.items[src->pool].buffer);
+        gls_bind_buffer(GL_COPY_WRITE_BUFFER, r->mesh_allocator.pools.items[dst->pool].buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            src->offset * r->vertex_size,
+                            dst->offset * r->vertex_size,
+                            mesh->quad_count * QUAD_VERTICES * r->vertex_size);
+
+        gpu_free(&r->mesh_allocator, mesh->allocation);
+    }
+
+    mesh->allocation = allocation;
+    mesh->quad_capacity = quad_capacity;
+}
+
+Mesh_Handle r_mesh_create(Renderer *r, size_t quad_capacity)
+{
+    if(quad_capacity == 0) quad_capacity = 1;
+
+    Mesh_Handle handle = r->meshes.count;
+    for(size_t i = 0; i < r->meshes.count; ++i) {
+        if(r->meshes.items[i].allocation == GPU_ALLOCATION_NONE) {
+            handle = i;
+            break;
+        }
+    }
+    if(handle == r->meshes.count) da_append(&r->meshes, (Mesh){0});
+
+    r_reserve_quad_indices(r, quad_capacity);
+
+    Mesh *mesh = &r->meshes.items[handle];
+    *mesh = (Mesh){.allocation = GPU_ALLOCATION_NONE, .position_scale = r->position_scale};
+    r_mesh_reallocate(r, mesh, quad_capacity);
+
+    return handle;
+}
+
+void r_mesh_destroy(Renderer *r, Mesh_Handle handle)
+{
+    assert(handle < r->meshes.count);
+    Mesh *mesh = &r->meshes.items[handle];
+
+    // Queued draws of the mesh would resolve its block after it's freed, or
+    // draw whatever mesh reuses the handle, so they go with it.
+    size_t kept = 0;
+    for(size_t i = 0; i < r->commands.count; ++i) {
+        if(r->commands.items[i].mesh == handle + 1) continue;
+        r->commands.items[kept++] = r->commands.items[i];
+    }
+    r->commands.count = kept;
+
+    gpu_free(&r->mesh_allocator, mesh->allocation);
+    *mesh = (Mesh){.allocation = GPU_ALLOCATION_NONE};
+
+    GPU_Allocator_Stats stats = gpu_allocator_stats(&r->mesh_allocator);
+    if(stats.fragmentation > MESH_DEFRAGMENT_THRESHOLD) {
+        gpu_allocator_defragment(&r->mesh_allocator);
+    }
+}
+
+static void r_mesh_write_quad(Renderer *r, Mesh *mesh, Quad_Handle quad, V2f p1, V2f p2, V4f color)
 {
-    glBufferSubData(GL_ARRAY_BUFFER,
-                    0,
-                    r->vertex_count * sizeof(Vertex),
-                    r->vertices);
+    // Meshes outlive the slot table, so they sample the texture of their sort key.
+    Vertex vertices[QUAD_VERTICES] = {
+        {p1,               v2f(0.0f, 0.0f), color, 0, 0},
+        {v2f(p2.x, p1.y),  v2f(1.0f, 0.0f), color, 0, 0},
+        {v2f(p1.x, p2.y),  v2f(0.0f, 1.0f), color, 0, 0},
+        {p2,               v2f(1.0f, 1.0f), color, 0, 0},
+    };
+
+    unsigned char encoded[QUAD_VERTICES * sizeof(Vertex)];
+    for(size_t i = 0; i < QUAD_VERTICES; ++i) {
+        r_encode_vertex(r, vertices[i], mesh->position_scale, encoded + i * r->vertex_size);
+    }
 
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
-                    0,
-                    r->index_count * sizeof(GLuint),
-                    r->indices);
+    const GPU_Block *block = gpu_block(&r->mesh_allocator, mesh->allocation);
+    size_t size = QUAD_VERTICES * r->vertex_size;
+
+    // The copy target leaves the batch's GL_ARRAY_BUFFER binding alone.
+    gls_bind_buffer(GL_COPY_WRITE_BUFFER, r->mesh_allocator.pools.items[block->pool].buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, block->offset * r->vertex_size + quad * size, size, encoded);
+
+    r->stats.bytes_uploaded += size;
+    r->stats.upload_calls += 1;
+}
+
+Quad_Handle r_mesh_quad_pp(Renderer *r, Mesh_Handle handle, V2f p1, V2f p2, V4f color)
+{
+    assert(handle < r->meshes.count);
+    Mesh *mesh = &r->meshes.items[handle];
+
+    if(mesh->quad_count >= mesh->quad_capacity) {
+        r_reserve_quad_indices(r, mesh->quad_capacity * 2);
+        r_mesh_reallocate(r, mesh, mesh->quad_capacity * 2);
+    }
+
+    Quad_Handle quad = mesh->quad_count++;
+    r_mesh_write_quad(r, mesh, quad, p1, p2, color);
+    return quad;
+}
+
+void r_mesh_update_quad(Renderer *r, Mesh_Handle handle, Quad_Handle quad, V2f p1, V2f p2, V4f color)
+{
+    assert(handle < r->meshes.count);
+    Mesh *mesh = &r->meshes.items[handle];
+    assert(quad < mesh->quad_count);
+
+    r_mesh_write_quad(r, mesh, quad, p1, p2, color);
+}
+
+// Queues the whole mesh with the current layer, program, texture and depth.
+void r_mesh_draw(Renderer *r, Mesh_Handle handle)
+{
+    assert(handle < r->meshes.count);
+    Mesh *mesh = &r->meshes.items[handle];
+    if(mesh->quad_count == 0) return;
+
+    Draw_Command command = {r_sort_key(r, false, r_keyed_texture(r, false)), 0, mesh->quad_count * QUAD_INDICES, handle + 1};
+    da_append(&r->commands, command);
+    r->stats.mesh_quads += mesh->quad_count;
+}
+
+void r_log_stats(const Renderer *r)
+{
+    LOG_INFO("frame: %zu vertices, %zu indices, %zu instances, %zu mesh quads, %zu commands in %zu draws "
+             "with %zu state changes, %zu bytes uploaded in %zu calls, %zu texture slot flushes",
+             r->stats.vertices, r->stats.indices, r->stats.instances, r->stats.mesh_quads,
+             r->stats.commands, r->stats.draw_calls, r->stats.state_changes,
+             r->stats.bytes_uploaded, r->stats.upload_calls, r->stats.slot_flushes);
+
+    GLS_Stats gl = gls_stats();
+    LOG_INFO("GL state: %zu of %zu calls suppressed as redundant", gl.suppressed, gl.calls);
+
+    GPU_Allocator_Stats mesh = gpu_allocator_stats(&r->mesh_allocator);
+    LOG_INFO("meshes: %zu allocations in %zu pools, %zu/%zu bytes used (%zu requested), "
+             "%.1f%% of free space fragmented",
+             mesh.allocations, mesh.pools, mesh.used, mesh.capacity, mesh.requested,
+             mesh.fragmentation * 100.0f);
 }
 
 /* Callbacks */
@@ -303,8 +2050,10 @@ static void glfw_error_callback(int error_code, const char *description)
 
 static void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
-    (void) window;
-    glViewport(0, 0, width, height);
+    gls_viewport(0, 0, width, height);
+
+    Renderer *r = glfwGetWindowUserPointer(window);
+    if(r) r_set_resolution(r, width, height);
 }
 
 static void key_callback(GLFWwindow *window,
@@ -320,7 +2069,7 @@ static void key_callback(GLFWwindow *window,
             } break;
 
             case GLFW_KEY_F5: {
-                if(r_reload_shaders(&global_renderer)) {
+                if(r_reload_shaders(glfwGetWindowUserPointer(window))) {
                     LOG_INFO("Successfully reloaded shaders");
                 }
             } break;
@@ -328,6 +2077,10 @@ static void key_callback(GLFWwindow *window,
             case GLFW_KEY_Z: {
                 r_toggle_wireframe();
             } break;
+
+            case GLFW_KEY_F3: {
+                show_stats = !show_stats;
+            } break;
         }
     }
 }
@@ -382,8 +2135,14 @@ void gl_debug_message_callback(GLenum source,
 int main(void)
 {
     int result = 0;
-    GLFWwindow *window;
-    Renderer *r = &global_renderer;
+    GLFWwindow *window = NULL;
+    Renderer *r = NULL;
+    Upload_Scheduler uploads = {0};
+    Texture_Loader *loader = NULL;
+    Atlas atlas = {0};
+    Texture_Array tiles = {0};
+    File_Watcher shader_watcher = {.fd = -1};
+    File_Paths changed_shaders = {0};
 
     reload_render_conf();
 
@@ -432,57 +2191,103 @@ int main(void)
 
     LOG_INFO("OpenGL %s", glGetString(GL_VERSION));
 
+    // Nothing is known about the fresh context until it's been set through the cache.
+    gls_invalidate();
+
     if(glDebugMessageCallback != NULL) {
         glEnable(GL_DEBUG_OUTPUT);
         glDebugMessageCallback(gl_debug_message_callback, 0);
     }
 
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    // Let the driver compile shaders on as many threads as it likes.
+    if(GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Images are decoded off the render thread; the placeholder is drawn until they arrive.
+    // Bulk uploads are spread over frames instead of stalling one.
+    upload_scheduler_init(&uploads, UPLOAD_FRAME_BYTES, UPLOAD_FRAME_SECONDS);
+    loader = texture_loader_create(TEXTURE_LOADER_WORKERS, &uploads);
+    texture_loader_set_budget(loader, TEXTURE_BUDGET);
+    Texture_Handle container = texture_loader_load(loader, "resources/textures/container.jpg", NULL, NULL);
 
-    // No magnification filter; mipmaps are for downscaling ig
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    // Small images are packed into shared atlas pages so they can be drawn in one batch.
+    atlas_init(&atlas, 2048, 4);
+    Atlas_Image crate = atlas_add_file_async(&atlas, loader, "resources/textures/container.jpg");
 
-    int tex_width, tex_height;
-    unsigned char *tex_data = stbi_load("resources/textures/container.jpg", &tex_width, &tex_height, NULL, 0);
+    // Same-size frames go into one array texture and are picked per quad by layer.
+    texture_array_load_dir(&tiles, loader, "resources/textures/tiles");
 
-    if(tex_data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
-                     tex_width, tex_height, 0, GL_RGB,
-                     GL_UNSIGNED_BYTE, tex_data);
-
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        LOG_ERROR("failed to load texture");
+    r = r_create(renderer_config);
+    glfwSetWindowUserPointer(window, r);
+    {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        r_set_resolution(r, width, height);
     }
-    stbi_image_free(tex_data);
 
-    glBindTexture(GL_TEXTURE_2D, texture);
+    // Saved shaders are picked up without pressing F5.
+    file_watcher_init(&shader_watcher, shaders_dir_path);
 
-    r_init(r);
-    r_reload_shaders(r);
-
-    r_quad_pp(r, v2f(-0.5f, -0.5f), v2f(0.5f, 0.5f), v4f(1.0f, 0.0f, 1.0f, 1.0f));
-    r_quad_cr(r, v2f(0.0f, 0.0f), v2ff(0.1f), v4f(1.0f, 0.0f, 0.0f, 1.0f));
+    // Static scenery lives in a retained mesh; only dynamic quads go through the batch.
+    Mesh_Handle background = r_mesh_create(r, 1);
+    r_mesh_quad_pp(r, background, v2f(-0.5f, -0.5f), v2f(0.5f, 0.5f), v4f(1.0f, 0.0f, 1.0f, 1.0f));
 
     time = glfwGetTime();
     double previous_time = 0.0f;
     double delta_time = 0.0f;
     while(!glfwWindowShouldClose(window)) {
+        // Before anything of the frame makes state calls, loader uploads included.
+        gls_reset_stats();
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        glUseProgram(r->programs[PROGRAM_BASIC]);
+        if(!file_watcher_poll(&shader_watcher, &changed_shaders)) {
+            // Any shader may have changed, so every variant is rebuilt.
+            r_reload_shaders(r);
+            file_paths_free(&changed_shaders);
+        } else if(changed_shaders.count > 0) {
+            r_reload_changed_shaders(r, &changed_shaders);
+            file_paths_free(&changed_shaders);
+        }
+        texture_loader_update(loader);
+        atlas_upload(&atlas);
+        upload_scheduler_run(&uploads);
+        r_begin_frame(r);
+        r_set_time(r, time);
+        r_set_program(r, PROGRAM_BASIC);
+        r_mesh_draw(r, background);
+        r_quad_cr(r, v2f(0.0f, 0.0f), v2ff(0.1f), v4f(1.0f, 0.0f, 0.0f, 1.0f));
+        if(texture_loader_status(loader, container) != TEXTURE_FAILED) {
+            r_set_program(r, PROGRAM_TEXTURE);
+            r_set_texture(r, texture_loader_texture(loader, container));
+            r_quad_pp(r, v2f(0.5f, 0.5f), v2f(0.9f, 0.9f), v4ff(1.0f));
+        }
+        if(atlas_status(&atlas, crate) == TEXTURE_READY) {
+            r_set_program(r, PROGRAM_TEXTURE);
+            r_set_texture(r, atlas_texture(&atlas, crate));
+            Atlas_UV_Rect uv = atlas_uv_rect(&atlas, crate);
+            r_quad_pp_uv(r, v2f(0.5f, -0.9f), v2f(0.9f, -0.5f), v4f(uv.u0, uv.v0, uv.u1, uv.v1), v4ff(1.0f));
+        }
+        if(tiles.status == TEXTURE_READY) {
+            r_set_program(r, PROGRAM_TEXTURE_ARRAY);
+            r_set_texture_array(r, tiles.texture);
+            r_set_texture_layer(r, (size_t) (time * 8.0) % tiles.layers);
+            r_quad_pp(r, v2f(-0.9f, 0.5f), v2f(-0.5f, 0.9f), v4ff(1.0f));
+        }
 
         /* glDrawArrays(GL_TRIANGLES, 0, r->vertex_count); */
-        r_sync_buffers(r);
-        glDrawElements(GL_TRIANGLES, r->index_count, GL_UNSIGNED_INT, 0);
+        r_flush(r);
+        if(show_stats) {
+            r_log_stats(r);
+
+            Texture_Loader_Stats textures = texture_loader_stats(loader);
+            LOG_INFO("textures: %zu/%zu bytes (%zu loaded), %zu resident, %zu evicted, "
+                     "%zu evictions, %zu mip drops, %zu reloads",
+                     textures.total_bytes, textures.budget, textures.loader_bytes, textures.resident,
+                     textures.evicted, textures.evictions, textures.mip_drops, textures.reloads);
+
+            Upload_Stats upload = upload_scheduler_stats(&uploads);
+            LOG_INFO("uploads: %zu issued with %zu bytes in %.3f ms, %zu queued",
+                     upload.uploads, upload.bytes, upload.seconds * 1000.0, upload.queued);
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -494,7 +2299,13 @@ int main(void)
     }
 
 defer:
-    r_deallocate(r);
+    file_watcher_deallocate(&shader_watcher);
+    file_paths_free(&changed_shaders);
+    if(r) r_destroy(r);
+    if(loader) texture_loader_destroy(loader);
+    atlas_deallocate(&atlas);
+    texture_array_deallocate(&tiles);
+    upload_scheduler_deallocate(&uploads);
     if(window) glfwDestroyWindow(window);
     glfwTerminate();
     if(render_conf) free(render_conf);
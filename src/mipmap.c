@@ -0,0 +1,212 @@
+#include "mipmap.h"
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif // __AVX2__
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#define MIPMAP_CHANNELS 4
+#define LINEAR_TO_SRGB_STEPS 4096
+
+static float srgb_to_linear[256];
+static uint8_t linear_to_srgb[LINEAR_TO_SRGB_STEPS];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void tables_init(void)
+{
+    for(int i = 0; i < 256; ++i) {
+        float c = i / 255.0f;
+        srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for(int i = 0; i < LINEAR_TO_SRGB_STEPS; ++i) {
+        float l = i / (float) (LINEAR_TO_SRGB_STEPS - 1);
+        float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+        linear_to_srgb[i] = (uint8_t) (c * 255.0f + 0.5f);
+    }
+}
+
+int mipmap_level_count(int width, int height)
+{
+    int levels = 1;
+    while(width > 1 || height > 1) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        levels += 1;
+    }
+    return levels;
+}
+
+// RGBA8 to linear, premultiplied float.
+static void level_decode(const unsigned char *rgba, size_t count, float *texels, Mipmap_Options options)
+{
+    for(size_t i = 0; i < count; ++i) {
+        const unsigned char *in = rgba + i * MIPMAP_CHANNELS;
+        float *out = texels + i * MIPMAP_CHANNELS;
+
+        float a = in[3] / 255.0f;
+        for(int c = 0; c < 3; ++c) {
+            out[c] = (options.srgb ? srgb_to_linear[in[c]] : in[c] / 255.0f) * a;
+        }
+        out[3] = a;
+    }
+}
+
+static unsigned char unorm8(float v)
+{
+    if(v <= 0.0f) return 0;
+    if(v >= 1.0f) return 255;
+    return (unsigned char) (v * 255.0f + 0.5f);
+}
+
+static void level_encode(const float *texels, size_t count, unsigned char *rgba,
+                         Mipmap_Options options, float alpha_scale)
+{
+    for(size_t i = 0; i < count; ++i) {
+        const float *in = texels + i * MIPMAP_CHANNELS;
+        unsigned char *out = rgba + i * MIPMAP_CHANNELS;
+
+        float a = in[3];
+        for(int c = 0; c < 3; ++c) {
+            float v = a > 0.0f ? in[c] / a : 0.0f;
+            if(options.srgb) {
+                if(v < 0.0f) v = 0.0f;
+                if(v > 1.0f) v = 1.0f;
+                out[c] = linear_to_srgb[(int) (v * (LINEAR_TO_SRGB_STEPS - 1) + 0.5f)];
+            } else {
+                out[c] = unorm8(v);
+            }
+        }
+        out[3] = unorm8(a * alpha_scale);
+    }
+}
+
+// 2x2 box filter. Odd sizes reuse the last row or column.
+static void level_downsample(const float *src, int src_width, int src_height,
+                             float *dst, int dst_width, int dst_height)
+{
+#ifdef __AVX2__
+    __m256 quarter8 = _mm256_set1_ps(0.25f);
+#endif // __AVX2__
+#ifdef __SSE2__
+    __m128 quarter = _mm_set1_ps(0.25f);
+#endif // __SSE2__
+
+    for(int y = 0; y < dst_height; ++y) {
+        int y0 = 2 * y < src_height ? 2 * y : src_height - 1;
+        int y1 = 2 * y + 1 < src_height ? 2 * y + 1 : src_height - 1;
+        const float *row0 = src + (size_t) y0 * src_width * MIPMAP_CHANNELS;
+        const float *row1 = src + (size_t) y1 * src_width * MIPMAP_CHANNELS;
+
+        int x = 0;
+#ifdef __AVX2__
+        // Two texels at a time while all four source columns are in range.
+        // Pairs are regrouped so every sum happens in the same order as below.
+        for(; x + 1 < dst_width && 2 * x + 3 < src_width; x += 2) {
+            int x0 = 2 * x * MIPMAP_CHANNELS;
+            __m256 a0 = _mm256_loadu_ps(row0 + x0), b0 = _mm256_loadu_ps(row0 + x0 + 8);
+            __m256 a1 = _mm256_loadu_ps(row1 + x0), b1 = _mm256_loadu_ps(row1 + x0 + 8);
+            __m256 top = _mm256_add_ps(_mm256_permute2f128_ps(a0, b0, 0x20),
+                                       _mm256_permute2f128_ps(a0, b0, 0x31));
+            __m256 bottom = _mm256_add_ps(_mm256_permute2f128_ps(a1, b1, 0x20),
+                                          _mm256_permute2f128_ps(a1, b1, 0x31));
+            _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_add_ps(top, bottom), quarter8));
+            dst += 2 * MIPMAP_CHANNELS;
+        }
+#endif // __AVX2__
+        for(; x < dst_width; ++x) {
+            int x0 = (2 * x < src_width ? 2 * x : src_width - 1) * MIPMAP_CHANNELS;
+            int x1 = (2 * x + 1 < src_width ? 2 * x + 1 : src_width - 1) * MIPMAP_CHANNELS;
+
+#ifdef __SSE2__
+            // One texel, all four channels at once.
+            __m128 top = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+            __m128 bottom = _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1));
+            _mm_storeu_ps(dst, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+#else
+            // Same grouping as the SSE2 path, so both produce identical texels.
+            for(int c = 0; c < MIPMAP_CHANNELS; ++c) {
+                dst[c] = ((row0[x0 + c] + row0[x1 + c]) + (row1[x0 + c] + row1[x1 + c])) * 0.25f;
+            }
+#endif // __SSE2__
+            dst += MIPMAP_CHANNELS;
+        }
+    }
+}
+
+static float alpha_coverage(const float *texels, size_t count, float reference)
+{
+    size_t passed = 0;
+    for(size_t i = 0; i < count; ++i) {
+        if(texels[i * MIPMAP_CHANNELS + 3] > reference) passed += 1;
+    }
+    return (float) passed / count;
+}
+
+// Alpha scale that makes `coverage` of the level pass the cutoff.
+static float alpha_coverage_scale(const float *texels, size_t count, float cutoff, float coverage)
+{
+    // Coverage only falls as the reference rises, so bisect for the reference
+    // that the base level's coverage passes at.
+    float lo = 0.0f, hi = 1.0f;
+    for(int i = 0; i < 16; ++i) {
+        float reference = (lo + hi) * 0.5f;
+        if(alpha_coverage(texels, count, reference) > coverage) {
+            lo = reference;
+        } else {
+            hi = reference;
+        }
+    }
+
+    float reference = (lo + hi) * 0.5f;
+    return reference > 0.0f ? cutoff / reference : 1.0f;
+}
+
+void mipmap_generate(unsigned char *chain, int width, int height, int levels, Mipmap_Options options)
+{
+    assert(levels <= mipmap_level_count(width, height));
+    if(levels <= 1) return;
+
+    pthread_once(&tables_once, tables_init);
+
+    size_t count = (size_t) width * height;
+    float *src = malloc(count * MIPMAP_CHANNELS * sizeof(float));
+    float *dst = malloc(count * MIPMAP_CHANNELS * sizeof(float));
+    assert(src != NULL && dst != NULL && "Buy more RAM lol");
+
+    level_decode(chain, count, src, options);
+
+    float coverage = 0.0f;
+    if(options.alpha_cutoff > 0.0f) coverage = alpha_coverage(src, count, options.alpha_cutoff);
+
+    unsigned char *out = chain + count * MIPMAP_CHANNELS;
+    for(int level = 1; level < levels; ++level) {
+        int dst_width = width > 1 ? width / 2 : 1;
+        int dst_height = height > 1 ? height / 2 : 1;
+        size_t dst_count = (size_t) dst_width * dst_height;
+
+        level_downsample(src, width, height, dst, dst_width, dst_height);
+
+        float alpha_scale = 1.0f;
+        if(options.alpha_cutoff > 0.0f) {
+            alpha_scale = alpha_coverage_scale(dst, dst_count, options.alpha_cutoff, coverage);
+        }
+        level_encode(dst, dst_count, out, options, alpha_scale);
+        out += dst_count * MIPMAP_CHANNELS;
+
+        // Next level filters the unscaled float texels of this one.
+        float *t = src; src = dst; dst = t;
+        width = dst_width;
+        height = dst_height;
+    }
+
+    free(src);
+    free(dst);
+}
@@ -0,0 +1,35 @@
+#ifndef MIPMAP_H_
+#define MIPMAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * CPU Mip Chain Generation
+ *
+ * Builds every level of an RGBA8 chain with a 2x2 box filter, so the result
+ * doesn't depend on the driver's glGenerateMipmap and can run on a loader
+ * thread and be cached.
+ *
+ * Filtering happens on linear, premultiplied float texels, so sRGB images
+ * don't darken as they shrink and transparent texels don't bleed their
+ * color into their neighbours. Each level is filtered from the float level
+ * above, not from its 8 bit encoding, so rounding doesn't add up either.
+ *
+ * Alpha tested textures lose coverage with every level as alpha averages
+ * towards the cutoff. With alpha_cutoff set, alpha of every level is scaled
+ * so the share of texels passing the test matches the base level.
+ */
+
+typedef struct {
+    bool srgb;           // color is sRGB encoded; filter it in linear space
+    float alpha_cutoff;  // alpha test reference whose coverage to keep, 0 to leave alpha alone
+} Mipmap_Options;
+
+int mipmap_level_count(int width, int height);
+
+// Fills levels 1.. of an RGBA8 chain laid out back to back, largest first,
+// whose base level is already in place.
+void mipmap_generate(unsigned char *chain, int width, int height, int levels, Mipmap_Options options);
+
+#endif // MIPMAP_H_
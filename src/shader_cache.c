@@ -0,0 +1,155 @@
+#include "shader_cache.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filesystem.h"
+#include "hash.h"
+#include "logger.h"
+
+#define SHADER_CACHE_MAGIC 0x43444853  // "SHDC"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;  // binary format reported by the driver
+    uint32_t size;
+} Shader_Cache_Header;
+
+// Hashes the terminator too, so the boundary between strings counts.
+static uint64_t fnv1a_cstr(uint64_t hash, const char *cstr)
+{
+    if(cstr == NULL) cstr = "";
+    return fnv1a(hash, cstr, strlen(cstr) + 1);
+}
+
+static bool shader_cache_supported(void)
+{
+    static int supported = -1;
+    if(supported < 0) {
+        GLint formats = 0;
+        if(GLEW_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0;
+        if(!supported) LOG_INFO("program binaries are not supported, shaders are always compiled");
+    }
+    return supported;
+}
+
+static void cache_path(uint64_t key, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%016" PRIx64 ".bin", SHADER_CACHE_DIR, key);
+}
+
+uint64_t shader_cache_key(const char *vertex_source, const char *fragment_source)
+{
+    const uint32_t version = SHADER_CACHE_VERSION;
+    uint64_t key = fnv1a(FNV_OFFSET_BASIS, &version, sizeof(version));
+    key = fnv1a_cstr(key, vertex_source);
+    key = fnv1a_cstr(key, fragment_source);
+
+    // A binary is only good for the driver that produced it.
+    key = fnv1a_cstr(key, (const char *) glGetString(GL_VENDOR));
+    key = fnv1a_cstr(key, (const char *) glGetString(GL_RENDERER));
+    key = fnv1a_cstr(key, (const char *) glGetString(GL_VERSION));
+    return key;
+}
+
+bool shader_cache_load(uint64_t key, GLuint *program)
+{
+    if(!shader_cache_supported()) return false;
+
+    char path[PATH_MAX];
+    cache_path(key, path, sizeof(path));
+
+    File_Mapping mapping;
+    if(!map_file(path, &mapping)) {
+        if(errno != ENOENT) LOG_WARN("failed to read shader cache `%s`: %s", path, strerror(errno));
+        return false;
+    }
+
+    const Shader_Cache_Header *header = mapping.data;
+    if(mapping.size < sizeof(*header)
+       || header->magic != SHADER_CACHE_MAGIC
+       || header->version != SHADER_CACHE_VERSION
+       || header->key != key
+       || header->size == 0
+       || header->size > INT_MAX
+       || mapping.size != sizeof(*header) + header->size) {
+        LOG_WARN("ignoring corrupt shader cache `%s`", path);
+        unmap_file(&mapping);
+        return false;
+    }
+
+    GLuint loaded = glCreateProgram();
+    glProgramBinary(loaded, header->format, header + 1, header->size);
+    unmap_file(&mapping);
+
+    GLint linked = 0;
+    glGetProgramiv(loaded, GL_LINK_STATUS, &linked);
+    if(!linked) {
+        // Usually a driver update that kept its version string.
+        LOG_INFO("driver rejected cached program `%s`, compiling from source", path);
+        glDeleteProgram(loaded);
+        return false;
+    }
+
+    *program = loaded;
+    return true;
+}
+
+void shader_cache_store(uint64_t key, GLuint program)
+{
+    if(!shader_cache_supported()) return;
+
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if(size <= 0) {
+        LOG_WARN("driver returned no binary for program %u", program);
+        return;
+    }
+
+    void *binary = malloc(size);
+    assert(binary != NULL && "Buy more RAM lol");
+
+    GLenum format = 0;
+    GLsizei length = 0;
+    glGetProgramBinary(program, size, &length, &format, binary);
+
+    char path[PATH_MAX];
+    cache_path(key, path, sizeof(path));
+
+    Shader_Cache_Header header = {
+        .magic = SHADER_CACHE_MAGIC,
+        .version = SHADER_CACHE_VERSION,
+        .key = key,
+        .format = format,
+        .size = length,
+    };
+    const File_Part parts[] = {
+        {&header, sizeof(header)},
+        {binary, length},
+    };
+
+    if(length <= 0) {
+        LOG_WARN("driver returned no binary for program %u", program);
+    } else if(!make_directories(SHADER_CACHE_DIR)) {
+        LOG_WARN("failed to create `%s`: %s", SHADER_CACHE_DIR, strerror(errno));
+    } else if(!write_file_atomic(path, parts, sizeof(parts) / sizeof(parts[0]))) {
+        LOG_WARN("failed to write shader cache `%s`: %s", path, strerror(errno));
+    }
+
+    free(binary);
+}
+
+void shader_cache_prepare(GLuint program)
+{
+    if(GLEW_ARB_get_program_binary) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef SHADER_CACHE_H_
+#define SHADER_CACHE_H_
+
+#include <GL/glew.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Program Binary Cache
+ *
+ * Compiling and linking every program from source on each launch gets slow
+ * as shaders pile up. Once a program links, its driver binary is saved with
+ * glGetProgramBinary() into SHADER_CACHE_DIR, and later launches hand it
+ * straight back with glProgramBinary().
+ *
+ * Entries are named after a hash of the sources together with the driver's
+ * vendor, renderer and version strings, so editing a shader or updating the
+ * driver misses the cache. Drivers may still reject a binary they wrote, in
+ * which case the caller compiles from source as if it had missed.
+ *
+ * Without ARB_get_program_binary, or with a driver that offers no binary
+ * formats, every lookup misses and nothing is stored. Every call needs the
+ * GL context current.
+ */
+
+#define SHADER_CACHE_DIR ".cache/shaders"
+
+// Bump whenever the file layout changes.
+#define SHADER_CACHE_VERSION 1
+
+uint64_t shader_cache_key(const char *vertex_source, const char *fragment_source);
+
+// Creates a linked program from the cached binary. Returns false on a miss
+// or when the driver rejects the binary, leaving *program alone.
+bool shader_cache_load(uint64_t key, GLuint *program);
+
+// Saves the binary of a linked program. Failing only logs.
+void shader_cache_store(uint64_t key, GLuint program);
+
+// Programs have to be linked with this for their binary to be retrievable.
+void shader_cache_prepare(GLuint program);
+
+#endif // SHADER_CACHE_H_
@@ -0,0 +1,168 @@
+#include "shader_preprocess.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dynamic_array.h"
+#include "logger.h"
+#include "string_builder.h"
+
+#define return_defer(value) do { result = (value); goto defer; } while(0)
+
+static size_t files_index(File_Paths *files, const char *file_path)
+{
+    for(size_t i = 0; i < files->count; ++i) {
+        if(strcmp(files->items[i], file_path) == 0) return i;
+    }
+
+    char *path = strdup(file_path);
+    assert(path != NULL && "Buy more RAM lol");
+    da_append(files, path);
+    return files->count - 1;
+}
+
+static void sb_append_line_directive(String_Builder *sb, size_t line, size_t file)
+{
+    char directive[64];
+    int n = snprintf(directive, sizeof(directive), "#line %zu %zu\n", line, file);
+    sb_append_buf(sb, directive, (size_t) n);
+}
+
+// Path of an #include relative to the directory of the including file.
+static char *include_path(const char *includer, const char *name, size_t name_len)
+{
+    const char *slash = strrchr(includer, '/');
+    size_t dir_len = slash ? (size_t) (slash - includer) + 1 : 0;
+
+    char *path = malloc(dir_len + name_len + 1);
+    assert(path != NULL && "Buy more RAM lol");
+    memcpy(path, includer, dir_len);
+    memcpy(path + dir_len, name, name_len);
+    path[dir_len + name_len] = '\0';
+    return path;
+}
+
+static const char *skip_blanks(const char *p, const char *end)
+{
+    while(p < end && isblank((unsigned char) *p)) p += 1;
+    return p;
+}
+
+// Whether the line is the given directive, with *rest pointing after its name.
+static bool is_directive(const char *line, const char *end, const char *directive, const char **rest)
+{
+    line = skip_blanks(line, end);
+    if(line == end || *line != '#') return false;
+    line = skip_blanks(line + 1, end);
+
+    size_t len = strlen(directive);
+    if((size_t) (end - line) < len || memcmp(line, directive, len) != 0) return false;
+    *rest = line + len;
+    return true;
+}
+
+// The name of `#include "name"`, ignoring blanks around it.
+static bool parse_include(const char *rest, const char *end, const char **name, size_t *name_len)
+{
+    rest = skip_blanks(rest, end);
+    if(rest == end || *rest != '"') return false;
+
+    const char *close = memchr(rest + 1, '"', end - rest - 1);
+    if(close == NULL || skip_blanks(close + 1, end) != end) return false;
+
+    *name = rest + 1;
+    *name_len = close - rest - 1;
+    return true;
+}
+
+static bool preprocess_file(const char *file_path, const char *const *defines, size_t define_count,
+                            size_t depth, String_Builder *sb, File_Paths *files)
+{
+    if(depth > SHADER_INCLUDE_DEPTH) {
+        LOG_ERROR("failed to preprocess `%s`: includes nested deeper than %d, is there a cycle?",
+                  file_path, SHADER_INCLUDE_DEPTH);
+        return false;
+    }
+
+    char *source = slurp_file(file_path);
+    if(source == NULL) {
+        LOG_ERROR("failed to read file `%s`: %s", file_path, strerror(errno));
+        return false;
+    }
+
+    bool result = true;
+    size_t file = files_index(files, file_path);
+    size_t line_number = 1;
+
+    const char *line = source;
+    if(depth == 0) {
+        // #version has to come first, so the defines go right after it.
+        const char *end = strchr(line, '\n');
+        if(end == NULL) end = line + strlen(line);
+        const char *rest;
+        if(is_directive(line, end, "version", &rest)) {
+            sb_append_buf(sb, line, (size_t) (end - line));
+            sb_append_buf(sb, "\n", 1);
+            line = *end ? end + 1 : end;
+            line_number += 1;
+        }
+        for(size_t i = 0; i < define_count; ++i) {
+            sb_append_cstr(sb, "#define ");
+            sb_append_cstr(sb, defines[i]);
+            sb_append_buf(sb, "\n", 1);
+        }
+    }
+    sb_append_line_directive(sb, line_number, file);
+
+    while(*line) {
+        const char *end = strchr(line, '\n');
+        if(end == NULL) end = line + strlen(line);
+
+        const char *rest;
+        if(is_directive(line, end, "include", &rest)) {
+            const char *name;
+            size_t name_len;
+            if(!parse_include(rest, end, &name, &name_len)) {
+                LOG_ERROR("%s:%zu: malformed #include, expected `#include \"path\"`", file_path, line_number);
+                return_defer(false);
+            }
+
+            char *path = include_path(file_path, name, name_len);
+            bool ok = preprocess_file(path, defines, define_count, depth + 1, sb, files);
+            free(path);
+            if(!ok) {
+                LOG_ERROR("included from `%s:%zu`", file_path, line_number);
+                return_defer(false);
+            }
+            sb_append_line_directive(sb, line_number + 1, file);
+        } else {
+            sb_append_buf(sb, line, (size_t) (end - line));
+            sb_append_buf(sb, "\n", 1);
+        }
+
+        line = *end ? end + 1 : end;
+        line_number += 1;
+    }
+
+defer:
+    free(source);
+    return result;
+}
+
+char *shader_preprocess(const char *file_path, const char *const *defines, size_t define_count,
+                        File_Paths *files)
+{
+    String_Builder sb = {0};
+    if(!preprocess_file(file_path, defines, define_count, 0, &sb, files)) {
+        free(sb.items);
+        return NULL;
+    }
+
+    sb_append_buf(&sb, "\0", 1);
+    return sb.items;
+}
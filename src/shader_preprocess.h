@@ -0,0 +1,32 @@
+#ifndef SHADER_PREPROCESS_H_
+#define SHADER_PREPROCESS_H_
+
+#include <stddef.h>
+
+#include "filesystem.h"
+
+/**
+ * GLSL Preprocessing
+ *
+ * GLSL has no #include, and the permutations of one shader need their
+ * feature macros defined before any code. shader_preprocess() reads a
+ * shader and
+ *
+ *   - replaces every `#include "path"` line with the preprocessed contents
+ *     of path, relative to the directory of the including file;
+ *   - inserts `#define NAME` for every define right after the #version line.
+ *
+ * Everything else, #ifdef on those defines included, is left to the GLSL
+ * compiler. #line directives keep its errors pointing at the right line,
+ * with the index of the file in files as the source string number.
+ */
+
+#define SHADER_INCLUDE_DEPTH 16
+
+// Returns the NUL terminated source, or NULL after logging why it failed.
+// Appends every file read, the shader itself first, to files unless it's
+// already there.
+char *shader_preprocess(const char *file_path, const char *const *defines, size_t define_count,
+                        File_Paths *files);
+
+#endif // SHADER_PREPROCESS_H_
@@ -0,0 +1,187 @@
+#include "shader_reflect.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dynamic_array.h"
+
+static bool uniform_type_is_sampler(GLenum type)
+{
+    switch(type) {
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_1D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_1D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_BUFFER:
+        case GL_SAMPLER_2D_RECT:
+        case GL_SAMPLER_2D_RECT_SHADOW:
+        case GL_INT_SAMPLER_1D:
+        case GL_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_3D:
+        case GL_INT_SAMPLER_CUBE:
+        case GL_INT_SAMPLER_1D_ARRAY:
+        case GL_INT_SAMPLER_2D_ARRAY:
+        case GL_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_INT_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D_RECT:
+        case GL_UNSIGNED_INT_SAMPLER_1D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_3D:
+        case GL_UNSIGNED_INT_SAMPLER_CUBE:
+        case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void reflect_uniforms(GLuint program, Program_Reflection *reflection)
+{
+    GLint count = 0;
+    GLint max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    char *name = malloc((size_t) max_length + 1);
+    assert(name != NULL && "Buy more RAM lol");
+
+    for(GLuint i = 0; i < (GLuint) count; ++i) {
+        GLint block = -1;
+        glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block);
+
+        GLsizei length = 0;
+        Program_Uniform uniform = {.location = -1, .offset = -1};
+        glGetActiveUniform(program, i, max_length + 1, &length, &uniform.size, &uniform.type, name);
+        name[length] = '\0';
+
+        if(block < 0) {
+            // Built-ins like gl_DepthRange show up too, but have no location.
+            uniform.location = glGetUniformLocation(program, name);
+            if(uniform.location < 0) continue;
+        } else {
+            glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_OFFSET, &uniform.offset);
+        }
+
+        char *bracket = strchr(name, '[');
+        if(bracket != NULL) *bracket = '\0';
+        uniform.name = strdup(name);
+        assert(uniform.name != NULL && "Buy more RAM lol");
+
+        if(block >= 0) {
+            // Blocks are reflected first, and GL numbers them 0.. in order.
+            assert((size_t) block < reflection->blocks.count);
+            da_append(&reflection->blocks.items[block].members, uniform);
+        } else if(uniform_type_is_sampler(uniform.type)) {
+            da_append(&reflection->samplers, uniform);
+        } else {
+            da_append(&reflection->uniforms, uniform);
+        }
+    }
+
+    free(name);
+}
+
+static void reflect_blocks(GLuint program, Program_Reflection *reflection)
+{
+    GLint count = 0;
+    GLint max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+
+    for(GLuint i = 0; i < (GLuint) count; ++i) {
+        Program_Block block = {.index = i};
+        block.name = malloc((size_t) max_length + 1);
+        assert(block.name != NULL && "Buy more RAM lol");
+
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(program, i, max_length + 1, &length, block.name);
+        block.name[length] = '\0';
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.data_size);
+
+        da_append(&reflection->blocks, block);
+    }
+}
+
+void program_reflect(GLuint program, Program_Reflection *reflection)
+{
+    program_reflection_deallocate(reflection);
+    reflect_blocks(program, reflection);
+    reflect_uniforms(program, reflection);
+}
+
+static void program_uniforms_free(Program_Uniforms *uniforms)
+{
+    for(size_t i = 0; i < uniforms->count; ++i) free(uniforms->items[i].name);
+    free(uniforms->items);
+    *uniforms = (Program_Uniforms){0};
+}
+
+void program_reflection_deallocate(Program_Reflection *reflection)
+{
+    program_uniforms_free(&reflection->uniforms);
+    program_uniforms_free(&reflection->samplers);
+
+    for(size_t i = 0; i < reflection->blocks.count; ++i) {
+        free(reflection->blocks.items[i].name);
+        program_uniforms_free(&reflection->blocks.items[i].members);
+    }
+    free(reflection->blocks.items);
+    reflection->blocks = (Program_Blocks){0};
+}
+
+static const Program_Uniform *program_uniforms_find(const Program_Uniforms *uniforms, const char *name)
+{
+    for(size_t i = 0; i < uniforms->count; ++i) {
+        if(strcmp(uniforms->items[i].name, name) == 0) return &uniforms->items[i];
+    }
+    return NULL;
+}
+
+const Program_Uniform *program_uniform(const Program_Reflection *reflection, const char *name)
+{
+    return program_uniforms_find(&reflection->uniforms, name);
+}
+
+const Program_Uniform *program_sampler(const Program_Reflection *reflection, const char *name)
+{
+    return program_uniforms_find(&reflection->samplers, name);
+}
+
+const Program_Block *program_block(const Program_Reflection *reflection, const char *name)
+{
+    for(size_t i = 0; i < reflection->blocks.count; ++i) {
+        if(strcmp(reflection->blocks.items[i].name, name) == 0) return &reflection->blocks.items[i];
+    }
+    return NULL;
+}
+
+const Program_Uniform *program_block_member(const Program_Block *block, const char *name)
+{
+    return program_uniforms_find(&block->members, name);
+}
+
+bool program_bind_block(GLuint program, const Program_Reflection *reflection,
+                        const char *name, GLuint binding)
+{
+    const Program_Block *block = program_block(reflection, name);
+    if(block == NULL) return false;
+
+    glUniformBlockBinding(program, block->index, binding);
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef SHADER_REFLECT_H_
+#define SHADER_REFLECT_H_
+
+#include <GL/glew.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Program Reflection
+ *
+ * Reads the active uniforms and uniform blocks of a linked program back
+ * from GL once, so setting a uniform later is a lookup in these tables
+ * rather than a glGetUniformLocation() round trip to the driver.
+ *
+ * Uniforms are split into plain values and samplers. Arrays are listed
+ * once under their bare name, without the `[0]` GL reports, with size
+ * holding the element count. Uniforms that live in a block have no
+ * location and are listed as members of their block instead, with their
+ * byte offset in it.
+ */
+
+typedef struct {
+    char *name;
+    GLint location;  // -1 for block members
+    GLint offset;    // in bytes into the block, -1 outside of one
+    GLenum type;
+    GLint size;      // array elements, 1 for non-arrays
+} Program_Uniform;
+
+typedef struct {
+    Program_Uniform *items;
+    size_t count;
+    size_t capacity;
+} Program_Uniforms;
+
+typedef struct {
+    char *name;
+    GLuint index;
+    GLint data_size;  // in bytes, as laid out by the driver
+    Program_Uniforms members;
+} Program_Block;
+
+typedef struct {
+    Program_Block *items;
+    size_t count;
+    size_t capacity;
+} Program_Blocks;
+
+typedef struct {
+    Program_Uniforms uniforms;
+    Program_Uniforms samplers;
+    Program_Blocks blocks;
+} Program_Reflection;
+
+void program_reflect(GLuint program, Program_Reflection *reflection);
+void program_reflection_deallocate(Program_Reflection *reflection);
+
+// NULL when the program has no such active uniform, sampler or block.
+const Program_Uniform *program_uniform(const Program_Reflection *reflection, const char *name);
+const Program_Uniform *program_sampler(const Program_Reflection *reflection, const char *name);
+const Program_Block *program_block(const Program_Reflection *reflection, const char *name);
+const Program_Uniform *program_block_member(const Program_Block *block, const char *name);
+
+// Points the block at a uniform buffer binding point. Returns false if the
+// program has no such active block.
+bool program_bind_block(GLuint program, const Program_Reflection *reflection,
+                        const char *name, GLuint binding);
+
+#endif // SHADER_REFLECT_H_
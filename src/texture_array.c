@@ -0,0 +1,251 @@
+#include "texture_array.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dynamic_array.h"
+#include "filesystem.h"
+#include "gl_state.h"
+#include "logger.h"
+#include "texture_memory.h"
+
+static Texture_Cache_Options texture_array_options(Texture_Compression compression)
+{
+    return (Texture_Cache_Options) {
+        .mipmaps = true,
+        .mipmap = {.srgb = true},
+        .compression = compression,
+    };
+}
+
+static void texture_array_pending_free(Texture_Array *array)
+{
+    for(size_t i = 0; i < array->pending.count; ++i) {
+        texture_image_free(&array->pending.items[i].image);
+        free(array->pending.items[i].file_path);
+    }
+    free(array->pending.items);
+    free(array->dir_path);
+
+    array->pending = (Texture_Array_Layers){0};
+    array->dir_path = NULL;
+    array->loader = NULL;
+    array->waiting = 0;
+}
+
+static void texture_array_layer_decoded(void *context, size_t id, Texture_Image *image);
+
+static void texture_array_queue(Texture_Array *array, size_t index, Texture_Compression compression)
+{
+    Texture_Array_Layer *layer = &array->pending.items[index];
+    layer->reloading = compression == TEXTURE_COMPRESSION_BC3;
+    array->waiting += 1;
+    texture_loader_decode(array->loader, layer->file_path, texture_array_options(compression),
+                          texture_array_layer_decoded, array, index);
+}
+
+// Drops the layers that can't go into the array. Returns how many are left.
+static size_t texture_array_select(Texture_Array *array)
+{
+    GLint max_layers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    if(max_layers > UINT16_MAX + 1) max_layers = UINT16_MAX + 1;  // layers are u16 per vertex
+
+    size_t count = 0;
+    for(size_t i = 0; i < array->pending.count; ++i) {
+        Texture_Array_Layer *layer = &array->pending.items[i];
+        if(layer->failed) continue;
+
+        const Texture_Image *image = &layer->image;
+        if(count == 0) {
+            array->width = image->width;
+            array->height = image->height;
+        }
+
+        if(image->width != array->width || image->height != array->height) {
+            LOG_WARN("skipping `%s`: %dx%d doesn't match the %dx%d of the first layer",
+                     layer->file_path, image->width, image->height, array->width, array->height);
+        } else if(count >= (size_t) max_layers) {
+            LOG_WARN("skipping `%s`: array texture is limited to %d layers", layer->file_path, max_layers);
+        } else {
+            count += 1;
+            continue;
+        }
+
+        texture_image_free(&layer->image);
+        layer->failed = true;
+    }
+    return count;
+}
+
+static void texture_array_build(Texture_Array *array, Texture_Format format)
+{
+    const Texture_Array_Layer *first = NULL;
+    for(size_t i = 0; i < array->pending.count && first == NULL; ++i) {
+        if(!array->pending.items[i].failed) first = &array->pending.items[i];
+    }
+    assert(first != NULL);
+
+    glGenTextures(1, &array->texture);
+    gls_bind_texture(0, GL_TEXTURE_2D_ARRAY, array->texture);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Same size means the same number of levels, so every layer fills every level.
+    int levels = first->image.levels;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    GLenum internal_format = texture_format_gl(format);
+    bool compressed = texture_format_compressed(format);
+
+    size_t bytes = 0;
+    gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for(int level = 0; level < levels; ++level) {
+        int width, height;
+        texture_image_level(&first->image, level, &width, &height);
+        size_t layer_size = texture_format_size(format, width, height);
+        bytes += layer_size * array->layers;
+
+        if(compressed) {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, width, height, array->layers,
+                                   0, layer_size * array->layers, NULL);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, width, height, array->layers, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+
+        size_t layer = 0;
+        for(size_t i = 0; i < array->pending.count; ++i) {
+            if(array->pending.items[i].failed) continue;
+
+            const Texture_Image *image = &array->pending.items[i].image;
+            const unsigned char *pixels = image->pixels + texture_image_level(image, level, NULL, NULL);
+            if(compressed) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1,
+                                          internal_format, layer_size, pixels);
+            } else {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1,
+                                GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            }
+            layer += 1;
+        }
+    }
+
+    texture_memory_track(array->texture, bytes);
+}
+
+// Runs once every queued layer is back.
+static void texture_array_finish(Texture_Array *array)
+{
+    array->layers = texture_array_select(array);
+    if(array->layers == 0) {
+        LOG_ERROR("no usable images in `%s`", array->dir_path);
+        array->status = TEXTURE_FAILED;
+        texture_array_pending_free(array);
+        return;
+    }
+
+    // All layers share one format, so if any of them needed alpha the
+    // opaque ones are loaded again as BC3 as well.
+    Texture_Format format = TEXTURE_FORMAT_COUNT;
+    for(size_t i = 0; i < array->pending.count; ++i) {
+        const Texture_Array_Layer *layer = &array->pending.items[i];
+        if(layer->failed) continue;
+        if(format == TEXTURE_FORMAT_COUNT) format = layer->image.format;
+        if(layer->image.format != format) format = TEXTURE_FORMAT_BC3;
+    }
+    for(size_t i = 0; i < array->pending.count; ++i) {
+        Texture_Array_Layer *layer = &array->pending.items[i];
+        if(layer->failed || layer->image.format == format) continue;
+
+        texture_image_free(&layer->image);
+        texture_array_queue(array, i, TEXTURE_COMPRESSION_BC3);
+    }
+    if(array->waiting > 0) return;
+
+    texture_array_build(array, format);
+    array->status = TEXTURE_READY;
+    LOG_INFO("loaded %zu layers of %dx%d from `%s`", array->layers, array->width, array->height, array->dir_path);
+
+    texture_array_pending_free(array);
+}
+
+static void texture_array_layer_decoded(void *context, size_t id, Texture_Image *image)
+{
+    Texture_Array *array = context;
+    Texture_Array_Layer *layer = &array->pending.items[id];
+
+    if(image == NULL) {
+        if(layer->reloading) {
+            // A layer reloaded as BC3 can't be left out any more, the
+            // others were already checked against it.
+            LOG_ERROR("failed to reload `%s` as BC3", layer->file_path);
+            array->status = TEXTURE_FAILED;
+        } else {
+            LOG_WARN("skipping `%s`", layer->file_path);
+        }
+        layer->failed = true;
+    } else {
+        layer->image = *image;
+        *image = (Texture_Image){0};
+    }
+
+    array->waiting -= 1;
+    if(array->waiting > 0) return;
+
+    if(array->status == TEXTURE_FAILED) {
+        texture_array_pending_free(array);
+    } else {
+        texture_array_finish(array);
+    }
+}
+
+bool texture_array_load_dir(Texture_Array *array, Texture_Loader *loader, const char *dir_path)
+{
+    File_Paths paths = {0};
+
+    *array = (Texture_Array){0};
+
+    if(!list_directory(dir_path, &paths)) {
+        LOG_ERROR("failed to list directory `%s`: %s", dir_path, strerror(errno));
+        array->status = TEXTURE_FAILED;
+        return false;
+    }
+    if(paths.count == 0) {
+        LOG_ERROR("no usable images in `%s`", dir_path);
+        array->status = TEXTURE_FAILED;
+        file_paths_free(&paths);
+        return false;
+    }
+
+    array->status = TEXTURE_PENDING;
+    array->loader = loader;
+    array->dir_path = strdup(dir_path);
+    assert(array->dir_path != NULL && "Buy more RAM lol");
+
+    Texture_Compression compression = GLEW_EXT_texture_compression_s3tc
+        ? TEXTURE_COMPRESSION_AUTO
+        : TEXTURE_COMPRESSION_NONE;
+    for(size_t i = 0; i < paths.count; ++i) {
+        Texture_Array_Layer layer = {.file_path = strdup(paths.items[i])};
+        assert(layer.file_path != NULL && "Buy more RAM lol");
+        da_append(&array->pending, layer);
+        texture_array_queue(array, array->pending.count - 1, compression);
+    }
+
+    file_paths_free(&paths);
+    return true;
+}
+
+void texture_array_deallocate(Texture_Array *array)
+{
+    texture_array_pending_free(array);
+    if(array->texture) gls_delete_textures(1, &array->texture);
+    *array = (Texture_Array){0};
+}
@@ -0,0 +1,57 @@
+#ifndef TEXTURE_ARRAY_H_
+#define TEXTURE_ARRAY_H_
+
+#include <GL/glew.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "texture_cache.h"
+#include "texture_loader.h"
+
+/**
+ * 2D Array Textures
+ *
+ * Loads a directory of same-size images (sprite frames, tiles) into the
+ * layers of one GL_TEXTURE_2D_ARRAY with a single mip chain, in file name
+ * order. Every layer gets the full [0, 1] uv range to itself, so nothing
+ * bleeds between frames and no padding is needed.
+ *
+ * Layers are decoded on the texture loader's workers. The array stays
+ * pending until every one of them is back, and is built from them in the
+ * texture_loader_update() that delivers the last. The array has to outlive
+ * the loader, or at least every decode it queued.
+ */
+
+typedef struct {
+    char *file_path;
+    Texture_Image image;
+    bool reloading;         // queued again as BC3 to match the others
+    bool failed;
+} Texture_Array_Layer;
+
+typedef struct {
+    Texture_Array_Layer *items;
+    size_t count;
+    size_t capacity;
+} Texture_Array_Layers;
+
+typedef struct {
+    Texture_Status status;  // never TEXTURE_EVICTED
+    GLuint texture;
+    int width;
+    int height;
+    size_t layers;
+
+    // Only while pending.
+    Texture_Loader *loader;
+    char *dir_path;
+    Texture_Array_Layers pending;
+    size_t waiting;         // decodes that aren't back yet
+} Texture_Array;
+
+// Lists dir_path and queues its images. False if there's nothing to load.
+bool texture_array_load_dir(Texture_Array *array, Texture_Loader *loader, const char *dir_path);
+void texture_array_deallocate(Texture_Array *array);
+
+#endif // TEXTURE_ARRAY_H_
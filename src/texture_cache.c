@@ -0,0 +1,235 @@
+#include "texture_cache.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stb_image.h"
+
+#include "hash.h"
+#include "logger.h"
+
+#define TEXTURE_CACHE_CHANNELS 4
+#define TEXTURE_CACHE_MAGIC 0x43584554  // "TEXC"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t format;
+} Texture_Cache_Header;
+
+static bool cache_read(const char *cache_path, uint64_t key, Texture_Image *image)
+{
+    File_Mapping mapping;
+    if(!map_file(cache_path, &mapping)) {
+        if(errno != ENOENT) LOG_WARN("failed to read texture cache `%s`: %s", cache_path, strerror(errno));
+        return false;
+    }
+
+    const Texture_Cache_Header *header = mapping.data;
+    if(mapping.size < sizeof(*header)
+       || header->magic != TEXTURE_CACHE_MAGIC
+       || header->version != TEXTURE_CACHE_VERSION
+       || header->key != key
+       || header->width == 0 || header->width > INT_MAX
+       || header->height == 0 || header->height > INT_MAX
+       || header->levels == 0
+       || header->levels > (uint32_t) mipmap_level_count(header->width, header->height)
+       || header->format >= TEXTURE_FORMAT_COUNT
+       || mapping.size != sizeof(*header) + texture_format_chain_size(
+              header->format, header->width, header->height, header->levels)) {
+        LOG_WARN("ignoring corrupt texture cache `%s`", cache_path);
+        unmap_file(&mapping);
+        return false;
+    }
+
+    image->width = header->width;
+    image->height = header->height;
+    image->levels = header->levels;
+    image->format = header->format;
+    image->pixels = (const unsigned char *) (header + 1);
+    image->size = mapping.size - sizeof(*header);
+    image->mapping = mapping;
+    return true;
+}
+
+static void cache_write(const char *cache_path, uint64_t key, const Texture_Image *image)
+{
+    if(!make_directories(TEXTURE_CACHE_DIR)) {
+        LOG_WARN("failed to create `%s`: %s", TEXTURE_CACHE_DIR, strerror(errno));
+        return;
+    }
+
+    Texture_Cache_Header header = {
+        .magic = TEXTURE_CACHE_MAGIC,
+        .version = TEXTURE_CACHE_VERSION,
+        .key = key,
+        .width = image->width,
+        .height = image->height,
+        .levels = image->levels,
+        .format = image->format,
+    };
+
+    const File_Part parts[] = {
+        {&header, sizeof(header)},
+        {image->pixels, image->size},
+    };
+    if(!write_file_atomic(cache_path, parts, sizeof(parts) / sizeof(parts[0]))) {
+        LOG_WARN("failed to write texture cache `%s`: %s", cache_path, strerror(errno));
+    }
+}
+
+// Alpha is only ever fully off or fully on, and off somewhere: a cutout
+// that is meant to be alpha tested rather than blended.
+static bool texels_are_cutout(const unsigned char *rgba, size_t texel_count)
+{
+    bool transparent = false;
+    for(size_t i = 0; i < texel_count; ++i) {
+        unsigned char a = rgba[i * TEXTURE_CACHE_CHANNELS + 3];
+        if(a != 0x00 && a != 0xFF) return false;
+        if(a == 0x00) transparent = true;
+    }
+    return transparent;
+}
+
+static void image_compress(Texture_Image *image, Texture_Compression compression)
+{
+    Texture_Format format = TEXTURE_FORMAT_BC3;
+    if(compression == TEXTURE_COMPRESSION_AUTO
+       && texture_is_opaque(image->owned, (size_t) image->width * image->height)) {
+        format = TEXTURE_FORMAT_BC1;
+    }
+
+    Texture_Image compressed = *image;
+    compressed.format = format;
+    compressed.size = texture_format_chain_size(format, image->width, image->height, image->levels);
+    compressed.owned = malloc(compressed.size);
+    assert(compressed.owned != NULL && "Buy more RAM lol");
+    compressed.pixels = compressed.owned;
+
+    for(int level = 0; level < image->levels; ++level) {
+        int width, height;
+        size_t src = texture_image_level(image, level, &width, &height);
+        size_t dst = texture_image_level(&compressed, level, NULL, NULL);
+        texture_compress(format, image->owned + src, width, height, compressed.owned + dst);
+    }
+
+    free(image->owned);
+    *image = compressed;
+}
+
+bool texture_cache_load(const char *file_path, Texture_Cache_Options options, Texture_Image *image)
+{
+    *image = (Texture_Image){0};
+
+    File_Mapping source;
+    if(!map_file(file_path, &source)) {
+        LOG_ERROR("failed to read texture `%s`: %s", file_path, strerror(errno));
+        return false;
+    }
+    if(source.size > INT_MAX) {
+        LOG_ERROR("failed to load texture `%s`: file is too large", file_path);
+        unmap_file(&source);
+        return false;
+    }
+
+    uint32_t alpha_cutoff;
+    memcpy(&alpha_cutoff, &options.mipmap.alpha_cutoff, sizeof(alpha_cutoff));
+    const uint32_t format[] = {
+        TEXTURE_CACHE_VERSION, TEXTURE_CACHE_CHANNELS, options.mipmaps,
+        options.mipmap.srgb, alpha_cutoff, options.compression,
+    };
+    uint64_t key = fnv1a(FNV_OFFSET_BASIS, source.data, source.size);
+    key = fnv1a(key, format, sizeof(format));
+
+    char cache_path[PATH_MAX];
+    snprintf(cache_path, sizeof(cache_path), "%s/%016" PRIx64 ".tex", TEXTURE_CACHE_DIR, key);
+
+    if(cache_read(cache_path, key, image)) {
+        LOG_TRACE("texture `%s` loaded from cache `%s`", file_path, cache_path);
+        unmap_file(&source);
+        return true;
+    }
+
+    int width, height;
+    unsigned char *rgba = stbi_load_from_memory(source.data, source.size, &width, &height,
+                                                NULL, TEXTURE_CACHE_CHANNELS);
+    unmap_file(&source);
+    if(rgba == NULL) {
+        LOG_ERROR("failed to load texture `%s`: %s", file_path, stbi_failure_reason());
+        return false;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->levels = options.mipmaps ? mipmap_level_count(width, height) : 1;
+    image->format = TEXTURE_FORMAT_RGBA8;
+    image->size = texture_format_chain_size(image->format, width, height, image->levels);
+    image->owned = malloc(image->size);
+    assert(image->owned != NULL && "Buy more RAM lol");
+    image->pixels = image->owned;
+
+    memcpy(image->owned, rgba, (size_t) width * height * TEXTURE_CACHE_CHANNELS);
+    stbi_image_free(rgba);
+
+    // Cutouts keep their coverage down the chain instead of fading out. The
+    // key covers the source bytes, so the choice is stable per cache entry.
+    if(options.mipmaps && options.mipmap.alpha_cutoff <= 0.0f
+       && texels_are_cutout(image->owned, (size_t) width * height)) {
+        options.mipmap.alpha_cutoff = TEXTURE_CACHE_CUTOUT_ALPHA;
+    }
+
+    // The chain is filtered before compression, never from the blocks.
+    mipmap_generate(image->owned, width, height, image->levels, options.mipmap);
+
+    if(options.compression != TEXTURE_COMPRESSION_NONE) image_compress(image, options.compression);
+
+    cache_write(cache_path, key, image);
+    return true;
+}
+
+void texture_image_free(Texture_Image *image)
+{
+    unmap_file(&image->mapping);
+    free(image->owned);
+    *image = (Texture_Image){0};
+}
+
+size_t texture_image_level(const Texture_Image *image, int level, int *width, int *height)
+{
+    assert(level >= 0 && level < image->levels);
+
+    int w = image->width;
+    int h = image->height;
+    size_t offset = 0;
+    for(int i = 0; i < level; ++i) {
+        offset += texture_format_size(image->format, w, h);
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    if(width) *width = w;
+    if(height) *height = h;
+    return offset;
+}
+
+void texture_image_drop_levels(Texture_Image *image, int count)
+{
+    assert(count >= 0 && count < image->levels);
+
+    int width, height;
+    size_t offset = texture_image_level(image, count, &width, &height);
+    image->pixels += offset;
+    image->size -= offset;
+    image->width = width;
+    image->height = height;
+    image->levels -= count;
+}
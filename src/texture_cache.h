@@ -0,0 +1,70 @@
+#ifndef TEXTURE_CACHE_H_
+#define TEXTURE_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "filesystem.h"
+#include "mipmap.h"
+#include "texture_compress.h"
+
+/**
+ * Decoded Texture Cache
+ *
+ * Decoding a JPEG/PNG, building its mip chain and block compressing it
+ * happens once per source image. The result is stored in TEXTURE_CACHE_DIR
+ * as a raw file: a small header followed by every level back to back,
+ * largest first, in the format they're uploaded in. Later loads map that
+ * file and hand the levels out as they are.
+ *
+ * Files are named after a hash of the source file's bytes together with the
+ * options and TEXTURE_CACHE_VERSION, so editing an image, changing how it's
+ * processed or changing the format all miss the cache instead of reading a
+ * stale entry. Old entries are never read again and can be deleted freely.
+ */
+
+#define TEXTURE_CACHE_DIR ".cache/textures"
+
+// Bump whenever the file layout or the way levels are produced changes.
+#define TEXTURE_CACHE_VERSION 5
+
+// Alpha test reference assumed for images whose alpha is only 0 or 255.
+#define TEXTURE_CACHE_CUTOUT_ALPHA 0.5f
+
+typedef enum {
+    TEXTURE_COMPRESSION_NONE = 0,   // RGBA8
+    TEXTURE_COMPRESSION_AUTO,       // BC1 if every texel is opaque, BC3 otherwise
+    TEXTURE_COMPRESSION_BC3,
+} Texture_Compression;
+
+typedef struct {
+    bool mipmaps;  // store the full chain down to 1x1, not only the base level
+    Mipmap_Options mipmap;  // alpha_cutoff 0 picks TEXTURE_CACHE_CUTOUT_ALPHA for cutouts
+    Texture_Compression compression;
+} Texture_Cache_Options;
+
+typedef struct {
+    int width, height;              // of the base level
+    int levels;
+    Texture_Format format;
+    const unsigned char *pixels;    // levels back to back, largest first
+    size_t size;
+
+    File_Mapping mapping;           // backs pixels on a cache hit
+    unsigned char *owned;           // backs pixels on a miss
+} Texture_Image;
+
+// Loads file_path through the cache, decoding and storing it on a miss.
+// Failing to write the cache only logs, the image is still returned.
+bool texture_cache_load(const char *file_path, Texture_Cache_Options options, Texture_Image *image);
+void texture_image_free(Texture_Image *image);
+
+// Byte offset of level inside pixels, and its size in texels.
+size_t texture_image_level(const Texture_Image *image, int level, int *width, int *height);
+
+// Skips the count largest levels. Their storage stays with the image and is
+// freed by texture_image_free() like the rest.
+void texture_image_drop_levels(Texture_Image *image, int count);
+
+#endif // TEXTURE_CACHE_H_
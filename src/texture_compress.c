@@ -0,0 +1,270 @@
+#include "texture_compress.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#define BLOCK_TEXELS 16
+
+size_t texture_format_size(Texture_Format format, int width, int height)
+{
+    size_t blocks = (size_t) ((width + 3) / 4) * ((height + 3) / 4);
+    switch(format) {
+        case TEXTURE_FORMAT_RGBA8: return (size_t) width * height * 4;
+        case TEXTURE_FORMAT_BC1:   return blocks * 8;
+        case TEXTURE_FORMAT_BC3:   return blocks * 16;
+        default: assert(0 && "unreachable");
+    }
+    return 0;
+}
+
+size_t texture_format_chain_size(Texture_Format format, int width, int height, int levels)
+{
+    size_t size = 0;
+    for(int i = 0; i < levels; ++i) {
+        size += texture_format_size(format, width, height);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+
+bool texture_format_compressed(Texture_Format format)
+{
+    return format != TEXTURE_FORMAT_RGBA8;
+}
+
+GLenum texture_format_gl(Texture_Format format)
+{
+    switch(format) {
+        case TEXTURE_FORMAT_RGBA8: return GL_RGBA8;
+        case TEXTURE_FORMAT_BC1:   return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TEXTURE_FORMAT_BC3:   return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        default: assert(0 && "unreachable");
+    }
+    return GL_NONE;
+}
+
+bool texture_is_opaque(const unsigned char *rgba, size_t texel_count)
+{
+    for(size_t i = 0; i < texel_count; ++i) {
+        if(rgba[i * 4 + 3] != 0xFF) return false;
+    }
+    return true;
+}
+
+// Copies the 4x4 block at (bx, by), repeating the last row and column of
+// levels that aren't a multiple of 4.
+static void block_fetch(const unsigned char *rgba, int width, int height, int bx, int by,
+                        unsigned char block[BLOCK_TEXELS * 4])
+{
+    for(int y = 0; y < 4; ++y) {
+        int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+        for(int x = 0; x < 4; ++x) {
+            int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+            memcpy(block + (y * 4 + x) * 4, rgba + ((size_t) sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+static void block_bounds(const unsigned char block[BLOCK_TEXELS * 4], unsigned char lo[4], unsigned char hi[4])
+{
+#ifdef __SSE2__
+    __m128i a = _mm_loadu_si128((const __m128i *) (block + 0));
+    __m128i b = _mm_loadu_si128((const __m128i *) (block + 16));
+    __m128i c = _mm_loadu_si128((const __m128i *) (block + 32));
+    __m128i d = _mm_loadu_si128((const __m128i *) (block + 48));
+
+    __m128i min = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+    __m128i max = _mm_max_epu8(_mm_max_epu8(a, b), _mm_max_epu8(c, d));
+
+    // Fold the four texels left in each register into one.
+    min = _mm_min_epu8(min, _mm_srli_si128(min, 8));
+    min = _mm_min_epu8(min, _mm_srli_si128(min, 4));
+    max = _mm_max_epu8(max, _mm_srli_si128(max, 8));
+    max = _mm_max_epu8(max, _mm_srli_si128(max, 4));
+
+    uint32_t min_texel = _mm_cvtsi128_si32(min);
+    uint32_t max_texel = _mm_cvtsi128_si32(max);
+    memcpy(lo, &min_texel, 4);
+    memcpy(hi, &max_texel, 4);
+#else
+    memcpy(lo, block, 4);
+    memcpy(hi, block, 4);
+    for(int i = 1; i < BLOCK_TEXELS; ++i) {
+        for(int c = 0; c < 4; ++c) {
+            unsigned char v = block[i * 4 + c];
+            if(v < lo[c]) lo[c] = v;
+            if(v > hi[c]) hi[c] = v;
+        }
+    }
+#endif // __SSE2__
+}
+
+static uint16_t pack_565(const int color[3])
+{
+    int r = (color[0] * 31 + 127) / 255;
+    int g = (color[1] * 63 + 127) / 255;
+    int b = (color[2] * 31 + 127) / 255;
+    return (uint16_t) (r << 11 | g << 5 | b);
+}
+
+static void unpack_565(uint16_t packed, int color[3])
+{
+    int r = packed >> 11 & 0x1F;
+    int g = packed >> 5 & 0x3F;
+    int b = packed & 0x1F;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+// 2 bit palette indices for every texel, from its projection onto e0 -> e1.
+static uint32_t color_indices(const unsigned char block[BLOCK_TEXELS * 4], const int e0[3], const int e1[3])
+{
+    int dir[3] = {e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2]};
+    int len2 = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+    int base = e0[0] * dir[0] + e0[1] * dir[1] + e0[2] * dir[2];
+
+    // Position along the line in steps of 1/3, rounded: 0 is e0 and 3 is e1.
+    int steps[BLOCK_TEXELS];
+
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i d = _mm_setr_epi16(dir[0], dir[1], dir[2], 0, dir[0], dir[1], dir[2], 0);
+    __m128i b = _mm_set1_epi32(base);
+    __m128i t1 = _mm_set1_epi32(len2);
+    __m128i t3 = _mm_set1_epi32(3 * len2);
+    __m128i t5 = _mm_set1_epi32(5 * len2);
+
+    for(int i = 0; i < BLOCK_TEXELS; i += 4) {
+        __m128i texels = _mm_loadu_si128((const __m128i *) (block + i * 4));
+
+        // r*dr + g*dg and b*db + a*0 for two texels at a time.
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(texels, zero), d);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(texels, zero), d);
+        __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+        __m128i dots = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+
+        __m128i t = _mm_sub_epi32(dots, b);
+        t = _mm_add_epi32(_mm_slli_epi32(t, 2), _mm_slli_epi32(t, 1));  // * 6
+
+        // Every passed threshold is a -1 lane.
+        __m128i step = _mm_add_epi32(_mm_add_epi32(_mm_cmpgt_epi32(t, t1), _mm_cmpgt_epi32(t, t3)),
+                                     _mm_cmpgt_epi32(t, t5));
+        _mm_storeu_si128((__m128i *) (steps + i), _mm_sub_epi32(zero, step));
+    }
+#else
+    for(int i = 0; i < BLOCK_TEXELS; ++i) {
+        const unsigned char *texel = block + i * 4;
+        int t = 6 * (texel[0] * dir[0] + texel[1] * dir[1] + texel[2] * dir[2] - base);
+        steps[i] = (t > len2) + (t > 3 * len2) + (t > 5 * len2);
+    }
+#endif // __SSE2__
+
+    // The palette is ordered e0, e1, 2/3 e0 + 1/3 e1, 1/3 e0 + 2/3 e1.
+    static const uint32_t step_index[4] = {0, 2, 3, 1};
+
+    uint32_t indices = 0;
+    for(int i = 0; i < BLOCK_TEXELS; ++i) indices |= step_index[steps[i]] << (2 * i);
+    return indices;
+}
+
+static void color_block(const unsigned char block[BLOCK_TEXELS * 4], unsigned char out[8])
+{
+    unsigned char lo[4], hi[4];
+    block_bounds(block, lo, hi);
+
+    int mean[3] = {0};
+    for(int i = 0; i < BLOCK_TEXELS; ++i) {
+        for(int c = 0; c < 3; ++c) mean[c] += block[i * 4 + c];
+    }
+    for(int c = 0; c < 3; ++c) mean[c] /= BLOCK_TEXELS;
+
+    int cov_rg = 0, cov_bg = 0;
+    for(int i = 0; i < BLOCK_TEXELS; ++i) {
+        int g = block[i * 4 + 1] - mean[1];
+        cov_rg += (block[i * 4 + 0] - mean[0]) * g;
+        cov_bg += (block[i * 4 + 2] - mean[2]) * g;
+    }
+
+    // Pulling the box in a bit moves the endpoints off outliers, which
+    // lowers the error for the rest of the block.
+    int c0[3], c1[3];
+    for(int c = 0; c < 3; ++c) {
+        int inset = (hi[c] - lo[c]) >> 4;
+        c0[c] = hi[c] - inset;
+        c1[c] = lo[c] + inset;
+    }
+    if(cov_rg < 0) { int t = c0[0]; c0[0] = c1[0]; c1[0] = t; }
+    if(cov_bg < 0) { int t = c0[2]; c0[2] = c1[2]; c1[2] = t; }
+
+    // color0 > color1 selects the four color mode.
+    uint16_t p0 = pack_565(c0);
+    uint16_t p1 = pack_565(c1);
+    if(p0 < p1) { uint16_t t = p0; p0 = p1; p1 = t; }
+
+    uint32_t indices = 0;
+    if(p0 != p1) {
+        int e0[3], e1[3];
+        unpack_565(p0, e0);
+        unpack_565(p1, e1);
+        indices = color_indices(block, e0, e1);
+    }
+
+    out[0] = p0 & 0xFF;
+    out[1] = p0 >> 8;
+    out[2] = p1 & 0xFF;
+    out[3] = p1 >> 8;
+    for(int i = 0; i < 4; ++i) out[4 + i] = indices >> (8 * i) & 0xFF;
+}
+
+static void alpha_block(const unsigned char block[BLOCK_TEXELS * 4], unsigned char out[8])
+{
+    int a0 = block[3], a1 = block[3];
+    for(int i = 1; i < BLOCK_TEXELS; ++i) {
+        int a = block[i * 4 + 3];
+        if(a > a0) a0 = a;
+        if(a < a1) a1 = a;
+    }
+
+    // a0 > a1 selects the eight value mode: a0, a1, then six steps from a0 to a1.
+    uint64_t indices = 0;
+    if(a0 > a1) {
+        int range = a0 - a1;
+        for(int i = 0; i < BLOCK_TEXELS; ++i) {
+            int step = ((a0 - block[i * 4 + 3]) * 7 + range / 2) / range;
+            uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            indices |= index << (3 * i);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for(int i = 0; i < 6; ++i) out[2 + i] = indices >> (8 * i) & 0xFF;
+}
+
+void texture_compress(Texture_Format format, const unsigned char *rgba, int width, int height,
+                      unsigned char *out)
+{
+    assert(texture_format_compressed(format));
+
+    unsigned char block[BLOCK_TEXELS * 4];
+    for(int by = 0; by < (height + 3) / 4; ++by) {
+        for(int bx = 0; bx < (width + 3) / 4; ++bx) {
+            block_fetch(rgba, width, height, bx, by, block);
+
+            if(format == TEXTURE_FORMAT_BC3) {
+                alpha_block(block, out);
+                out += 8;
+            }
+            color_block(block, out);
+            out += 8;
+        }
+    }
+}
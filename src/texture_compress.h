@@ -0,0 +1,43 @@
+#ifndef TEXTURE_COMPRESS_H_
+#define TEXTURE_COMPRESS_H_
+
+#include <GL/glew.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * S3TC Block Compression
+ *
+ * CPU encoder for BC1 (DXT1, opaque RGB at 4 bits per texel) and BC3 (DXT5,
+ * RGBA at 8 bits per texel), against 32 bits per texel for RGBA8.
+ *
+ * Every 4x4 block gets the endpoints of its inset color bounding box, with
+ * the box diagonal picked from the sign of the red/green and blue/green
+ * covariance, and every texel the palette entry closest to its projection
+ * onto that line. That's a lot cheaper than an iterative fit and good
+ * enough for textures that get encoded once and then cached. Bounds and
+ * projections use SSE2 when it's available.
+ */
+
+typedef enum {
+    TEXTURE_FORMAT_RGBA8 = 0,
+    TEXTURE_FORMAT_BC1,
+    TEXTURE_FORMAT_BC3,
+    TEXTURE_FORMAT_COUNT,
+} Texture_Format;
+
+// Bytes taken by one width x height level.
+size_t texture_format_size(Texture_Format format, int width, int height);
+// Bytes taken by the first levels of a width x height chain, largest first.
+size_t texture_format_chain_size(Texture_Format format, int width, int height, int levels);
+bool texture_format_compressed(Texture_Format format);
+GLenum texture_format_gl(Texture_Format format);
+
+bool texture_is_opaque(const unsigned char *rgba, size_t texel_count);
+
+// Encodes an RGBA8 level into texture_format_size(format, width, height) bytes.
+void texture_compress(Texture_Format format, const unsigned char *rgba, int width, int height,
+                      unsigned char *out);
+
+#endif // TEXTURE_COMPRESS_H_
@@ -0,0 +1,833 @@
+#include "texture_loader.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dynamic_array.h"
+#include "gl_state.h"
+#include "logger.h"
+#include "texture_cache.h"
+#include "texture_memory.h"
+#include "upload_scheduler.h"
+
+// Undrawn for longer than this, a texture over budget is evicted rather
+// than shrunk by a mip level.
+#define TEXTURE_EVICT_FRAMES 120
+
+// New textures stream in through the upload scheduler, finer levels last.
+// Each step uploads at least one level and then as many as fit this size, so
+// the tiny ones go together and the texture is usable after the first.
+#define TEXTURE_STREAM_STEP_BYTES (64 * 1024)
+
+// Where a texture is in the pipeline. Owned by whoever holds the lock.
+typedef enum {
+    TEXTURE_STAGE_QUEUED = 0,  // waiting for a worker to decode it
+    TEXTURE_STAGE_DECODED,     // waiting for the render thread to map a PBO
+    TEXTURE_STAGE_COPYING,     // waiting for a worker to fill the PBO
+    TEXTURE_STAGE_COPIED,      // waiting for the render thread to upload it
+    TEXTURE_STAGE_STREAMING,   // usable, finer levels are uploaded over the next frames
+    TEXTURE_STAGE_DONE,
+    TEXTURE_STAGE_FAILED,
+} Texture_Stage;
+
+typedef struct {
+    char *file_path;
+    Texture_Callback callback;
+    void *user_data;
+
+    // Shared with the workers, guarded by the loader's mutex.
+    Texture_Stage stage;
+    int first_level;        // largest level the load in flight keeps
+    Texture_Image image;    // levels from first_level on
+    GLuint pbo;
+    void *mapped;
+
+    // Only touched by the render thread.
+    Texture_Status status;
+    bool in_flight;
+    bool scheduled;         // an upload step is queued with the scheduler
+    uint64_t last_used;     // frame it was last drawn in
+
+    GLuint texture;
+    int resident_level;     // level of the full chain the texture starts at
+    int width, height;      // of the resident top level
+    int levels;             // resident
+    int streamed_level;     // finest level uploaded while streaming
+    Texture_Format format;
+    size_t bytes;
+    size_t full_bytes;      // with every level resident
+    size_t reclaim;         // bytes the load in flight will free
+} Texture_Entry;
+
+typedef struct {
+    Texture_Entry *items;
+    size_t count;
+    size_t capacity;
+} Texture_Entries;
+
+// A texture_loader_decode() request.
+typedef struct {
+    char *file_path;
+    Texture_Cache_Options options;
+    Texture_Decode_Callback callback;
+    void *context;
+    size_t id;
+
+    // Shared with the workers, guarded by the loader's mutex.
+    bool decoded;
+    bool ok;
+    Texture_Image image;
+
+    // Only touched by the render thread.
+    bool delivered;
+} Texture_Decode;
+
+typedef struct {
+    Texture_Decode *items;
+    size_t count;
+    size_t capacity;
+} Texture_Decodes;
+
+typedef enum {
+    TEXTURE_JOB_DECODE = 0,
+    TEXTURE_JOB_COPY,
+    TEXTURE_JOB_IMAGE,  // handle indexes decodes rather than entries
+} Texture_Job_Kind;
+
+typedef struct {
+    Texture_Job_Kind kind;
+    Texture_Handle handle;
+} Texture_Job;
+
+typedef struct {
+    Texture_Job *items;
+    size_t count;
+    size_t capacity;
+    size_t head;  // jobs before head were taken
+} Texture_Jobs;
+
+struct Texture_Loader {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool quit;
+
+    pthread_t *workers;
+    size_t worker_count;
+
+    Texture_Entries entries;
+    Texture_Decodes decodes;
+    Texture_Decodes delivering;  // decodes handed to their callbacks this update
+    Texture_Jobs jobs;
+    size_t pending;  // entries the render thread hasn't finished
+    Texture_Compression compression;
+    Upload_Scheduler *uploads;
+
+    uint64_t frame;
+    size_t budget;
+    size_t reclaiming;  // bytes loads in flight will free once uploaded
+    size_t evictions;
+    size_t mip_drops;
+    size_t reloads;
+
+    GLuint placeholder;
+};
+
+static void jobs_push(Texture_Loader *loader, Texture_Job_Kind kind, Texture_Handle handle)
+{
+    da_append(&loader->jobs, ((Texture_Job){kind, handle}));
+    pthread_cond_signal(&loader->cond);
+}
+
+static void *texture_worker(void *arg)
+{
+    Texture_Loader *loader = arg;
+
+    pthread_mutex_lock(&loader->mutex);
+    for(;;) {
+        while(!loader->quit && loader->jobs.head == loader->jobs.count) {
+            pthread_cond_wait(&loader->cond, &loader->mutex);
+        }
+        if(loader->quit) break;
+
+        Texture_Job job = loader->jobs.items[loader->jobs.head++];
+        if(loader->jobs.head == loader->jobs.count) {
+            loader->jobs.head = 0;
+            loader->jobs.count = 0;
+        }
+
+        if(job.kind == TEXTURE_JOB_IMAGE) {
+            // Same as below, decodes may be reallocated while unlocked.
+            Texture_Decode *shared = &loader->decodes.items[job.handle];
+            const char *file_path = shared->file_path;
+            Texture_Cache_Options options = shared->options;
+            pthread_mutex_unlock(&loader->mutex);
+
+            Texture_Image image;
+            bool ok = texture_cache_load(file_path, options, &image);
+
+            pthread_mutex_lock(&loader->mutex);
+            Texture_Decode *d = &loader->decodes.items[job.handle];
+            d->image = image;
+            d->ok = ok;
+            d->decoded = true;
+            continue;
+        }
+
+        // Entries may be reallocated while unlocked, so only keep copies of
+        // the fields guarded by the lock.
+        Texture_Entry *shared = &loader->entries.items[job.handle];
+        const char *file_path = shared->file_path;
+        int first_level = shared->first_level;
+        Texture_Cache_Options options = {
+            .mipmaps = true,
+            .mipmap = {.srgb = true},
+            .compression = loader->compression,
+        };
+        Texture_Image image = shared->image;
+        void *mapped = shared->mapped;
+        pthread_mutex_unlock(&loader->mutex);
+
+        switch(job.kind) {
+            case TEXTURE_JOB_DECODE: {
+                // Errors are logged by the cache.
+                bool ok = texture_cache_load(file_path, options, &image);
+                if(ok) {
+                    if(first_level >= image.levels) first_level = image.levels - 1;
+                    texture_image_drop_levels(&image, first_level);
+                }
+
+                pthread_mutex_lock(&loader->mutex);
+                Texture_Entry *e = &loader->entries.items[job.handle];
+                e->first_level = first_level;
+                e->image = image;
+                e->stage = ok ? TEXTURE_STAGE_DECODED : TEXTURE_STAGE_FAILED;
+            } break;
+
+            case TEXTURE_JOB_COPY: {
+                memcpy(mapped, image.pixels, image.size);
+
+                // The pixels live in the PBO now, only the layout is needed for the upload.
+                Texture_Image layout = {
+                    .width = image.width,
+                    .height = image.height,
+                    .levels = image.levels,
+                    .format = image.format,
+                    .size = image.size,
+                };
+                texture_image_free(&image);
+
+                pthread_mutex_lock(&loader->mutex);
+                Texture_Entry *e = &loader->entries.items[job.handle];
+                e->image = layout;
+                e->stage = TEXTURE_STAGE_COPIED;
+            } break;
+
+            default: assert(0 && "unreachable");
+        }
+    }
+    pthread_mutex_unlock(&loader->mutex);
+
+    return NULL;
+}
+
+static GLuint create_placeholder(void)
+{
+    // 2x2 magenta and black checker, hard to mistake for a real texture.
+    static const unsigned char pixels[] = {
+        0xFF, 0x00, 0xFF, 0xFF,   0x00, 0x00, 0x00, 0xFF,
+        0x00, 0x00, 0x00, 0xFF,   0xFF, 0x00, 0xFF, 0xFF,
+    };
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gls_bind_texture(0, GL_TEXTURE_2D, texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    texture_memory_track(texture, sizeof(pixels));
+
+    return texture;
+}
+
+Texture_Loader *texture_loader_create(size_t worker_count, Upload_Scheduler *uploads)
+{
+    assert(worker_count > 0);
+    assert(uploads != NULL);
+
+    Texture_Loader *loader = calloc(1, sizeof(Texture_Loader));
+    assert(loader != NULL && "Buy more RAM lol");
+
+    pthread_mutex_init(&loader->mutex, NULL);
+    pthread_cond_init(&loader->cond, NULL);
+
+    loader->uploads = uploads;
+    loader->placeholder = create_placeholder();
+
+    // Block compressed textures take a quarter to an eighth of the memory and bandwidth.
+    if(GLEW_EXT_texture_compression_s3tc) {
+        loader->compression = TEXTURE_COMPRESSION_AUTO;
+    } else {
+        LOG_WARN("S3TC is not supported, textures are loaded uncompressed");
+        loader->compression = TEXTURE_COMPRESSION_NONE;
+    }
+
+    loader->workers = calloc(worker_count, sizeof(pthread_t));
+    assert(loader->workers != NULL && "Buy more RAM lol");
+
+    for(size_t i = 0; i < worker_count; ++i) {
+        int err = pthread_create(&loader->workers[i], NULL, texture_worker, loader);
+        if(err != 0) {
+            LOG_ERROR("failed to start texture worker %zu: %s", i, strerror(err));
+            break;
+        }
+        loader->worker_count += 1;
+    }
+    assert(loader->worker_count > 0 && "no texture workers, nothing would ever load");
+
+    return loader;
+}
+
+void texture_loader_destroy(Texture_Loader *loader)
+{
+    pthread_mutex_lock(&loader->mutex);
+    loader->quit = true;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->mutex);
+
+    for(size_t i = 0; i < loader->worker_count; ++i) {
+        pthread_join(loader->workers[i], NULL);
+    }
+    upload_cancel(loader->uploads, loader);
+
+    for(size_t i = 0; i < loader->entries.count; ++i) {
+        Texture_Entry *e = &loader->entries.items[i];
+        if(e->pbo) {
+            if(e->mapped) {
+                gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, e->pbo);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+            gls_delete_buffers(1, &e->pbo);
+        }
+        if(e->texture) gls_delete_textures(1, &e->texture);
+        texture_image_free(&e->image);
+        free(e->file_path);
+    }
+    gls_delete_textures(1, &loader->placeholder);
+
+    for(size_t i = 0; i < loader->decodes.count; ++i) {
+        texture_image_free(&loader->decodes.items[i].image);
+        free(loader->decodes.items[i].file_path);
+    }
+
+    free(loader->entries.items);
+    free(loader->decodes.items);
+    free(loader->delivering.items);
+    free(loader->jobs.items);
+    free(loader->workers);
+
+    pthread_cond_destroy(&loader->cond);
+    pthread_mutex_destroy(&loader->mutex);
+    free(loader);
+}
+
+// Queues a (re)load of the entry that keeps the levels from first_level on.
+// Must hold the lock.
+static void texture_queue(Texture_Loader *loader, Texture_Handle handle, int first_level)
+{
+    Texture_Entry *e = &loader->entries.items[handle];
+    e->first_level = first_level;
+    e->stage = TEXTURE_STAGE_QUEUED;
+    e->in_flight = true;
+    jobs_push(loader, TEXTURE_JOB_DECODE, handle);
+    loader->pending += 1;
+}
+
+Texture_Handle texture_loader_load(Texture_Loader *loader, const char *file_path,
+                                   Texture_Callback callback, void *user_data)
+{
+    Texture_Entry entry = {
+        .file_path = strdup(file_path),
+        .callback = callback,
+        .user_data = user_data,
+        .status = TEXTURE_PENDING,
+        .last_used = loader->frame,
+    };
+    assert(entry.file_path != NULL && "Buy more RAM lol");
+
+    pthread_mutex_lock(&loader->mutex);
+    da_append(&loader->entries, entry);
+    Texture_Handle handle = loader->entries.count - 1;
+    texture_queue(loader, handle, 0);
+    pthread_mutex_unlock(&loader->mutex);
+
+    return handle;
+}
+
+void texture_loader_decode(Texture_Loader *loader, const char *file_path, Texture_Cache_Options options,
+                           Texture_Decode_Callback callback, void *context, size_t id)
+{
+    assert(callback != NULL);
+
+    Texture_Decode decode = {
+        .file_path = strdup(file_path),
+        .options = options,
+        .callback = callback,
+        .context = context,
+        .id = id,
+    };
+    assert(decode.file_path != NULL && "Buy more RAM lol");
+
+    pthread_mutex_lock(&loader->mutex);
+    da_append(&loader->decodes, decode);
+    jobs_push(loader, TEXTURE_JOB_IMAGE, loader->decodes.count - 1);
+    pthread_mutex_unlock(&loader->mutex);
+}
+
+// Hands the decodes that finished since the last update to their callbacks.
+static void texture_loader_deliver(Texture_Loader *loader)
+{
+    loader->delivering.count = 0;
+
+    pthread_mutex_lock(&loader->mutex);
+    bool all_delivered = true;
+    for(size_t i = 0; i < loader->decodes.count; ++i) {
+        Texture_Decode *d = &loader->decodes.items[i];
+        if(d->delivered) continue;
+        if(!d->decoded) {
+            all_delivered = false;
+            continue;
+        }
+
+        da_append(&loader->delivering, *d);
+        d->image = (Texture_Image){0};
+        d->file_path = NULL;
+        d->delivered = true;
+    }
+    // No job refers to a delivered decode, so the list starts over once
+    // none are in flight.
+    if(all_delivered) loader->decodes.count = 0;
+    pthread_mutex_unlock(&loader->mutex);
+
+    // Callbacks run unlocked so they are free to queue more decodes.
+    for(size_t i = 0; i < loader->delivering.count; ++i) {
+        Texture_Decode *d = &loader->delivering.items[i];
+        d->callback(d->context, d->id, d->ok ? &d->image : NULL);
+        texture_image_free(&d->image);
+        free(d->file_path);
+    }
+}
+
+// Hands a worker a mapped PBO to copy the decoded pixels into.
+static void texture_map(Texture_Loader *loader, Texture_Handle handle)
+{
+    Texture_Entry *e = &loader->entries.items[handle];
+    size_t size = e->image.size;
+
+    glGenBuffers(1, &e->pbo);
+    gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, e->pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    e->mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if(e->mapped == NULL) {
+        LOG_ERROR("failed to map pixel buffer for `%s`", e->file_path);
+        gls_delete_buffers(1, &e->pbo);
+        e->pbo = 0;
+        texture_image_free(&e->image);
+        e->stage = TEXTURE_STAGE_FAILED;
+        return;
+    }
+
+    e->stage = TEXTURE_STAGE_COPYING;
+    jobs_push(loader, TEXTURE_JOB_COPY, handle);
+}
+
+static void texture_upload_level(const Texture_Image *layout, int level)
+{
+    int width, height;
+    size_t offset = texture_image_level(layout, level, &width, &height);
+    GLenum format = texture_format_gl(layout->format);
+    if(texture_format_compressed(layout->format)) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0,
+                               texture_format_size(layout->format, width, height), (void *) offset);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, (void *) offset);
+    }
+}
+
+static void texture_upload_done(Texture_Entry *e)
+{
+    // Deletion is deferred by GL until the transfer is done.
+    gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gls_delete_buffers(1, &e->pbo);
+    e->pbo = 0;
+
+    e->image = (Texture_Image){0};
+    e->stage = TEXTURE_STAGE_DONE;
+}
+
+// The level a stream step starting above streamed_level gets down to, and
+// the bytes it uploads.
+static int texture_stream_step(const Texture_Image *layout, int streamed_level, size_t *bytes)
+{
+    int level = streamed_level;
+    *bytes = 0;
+    while(level > 0) {
+        int width, height;
+        texture_image_level(layout, level - 1, &width, &height);
+        size_t size = texture_format_size(layout->format, width, height);
+        if(*bytes > 0 && *bytes + size > TEXTURE_STREAM_STEP_BYTES) break;
+
+        level -= 1;
+        *bytes += size;
+    }
+    return level;
+}
+
+// Uploads the next step of finer levels of a streaming texture out of its
+// PBO and lowers the base level to the finest one.
+static void texture_stream(Texture_Entry *e)
+{
+    size_t bytes;
+    int level = texture_stream_step(&e->image, e->streamed_level, &bytes);
+
+    gls_bind_texture(0, GL_TEXTURE_2D, e->texture);
+    gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, e->pbo);
+
+    while(e->streamed_level > level) {
+        e->streamed_level -= 1;
+        texture_upload_level(&e->image, e->streamed_level);
+    }
+
+    // Only base level and up have to be defined for the texture to be complete.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, e->streamed_level);
+    gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    e->bytes += bytes;
+    texture_memory_track(e->texture, e->bytes);
+
+    if(e->streamed_level == 0) texture_upload_done(e);
+}
+
+// Starts the transfer out of the filled PBO. The texture is usable right
+// away; GL orders the upload before any draw that samples it.
+//
+// New textures stream in from the smallest level, so they show up blurry
+// within a frame and sharpen over the next ones. Reloads are replacing a
+// texture that's on screen, so they upload every level at once and swap.
+static void texture_upload(Texture_Loader *loader, Texture_Handle handle)
+{
+    Texture_Entry *e = &loader->entries.items[handle];
+
+    gls_bind_buffer(GL_PIXEL_UNPACK_BUFFER, e->pbo);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    e->mapped = NULL;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gls_bind_texture(0, GL_TEXTURE_2D, texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, e->image.levels - 1);
+
+    bool streaming = e->texture == 0;
+    if(!streaming) {
+        // The mip chain comes from the cache, so there's nothing to generate.
+        for(int level = 0; level < e->image.levels; ++level) texture_upload_level(&e->image, level);
+        gls_delete_textures(1, &e->texture);
+    }
+
+    e->texture = texture;
+    e->resident_level = e->first_level;
+    e->width = e->image.width;
+    e->height = e->image.height;
+    e->levels = e->image.levels;
+    e->format = e->image.format;
+    if(e->resident_level == 0) e->full_bytes = e->image.size;
+
+    if(streaming) {
+        e->bytes = 0;
+        e->streamed_level = e->image.levels;
+        e->stage = TEXTURE_STAGE_STREAMING;
+        texture_stream(e);
+    } else {
+        e->bytes = e->image.size;
+        texture_memory_track(e->texture, e->bytes);
+        texture_upload_done(e);
+    }
+}
+
+static void texture_upload_job(void *context, size_t handle)
+{
+    Texture_Loader *loader = context;
+
+    pthread_mutex_lock(&loader->mutex);
+    Texture_Entry *e = &loader->entries.items[handle];
+    e->scheduled = false;
+    if(e->stage == TEXTURE_STAGE_COPIED) {
+        texture_upload(loader, handle);
+    } else if(e->stage == TEXTURE_STAGE_STREAMING) {
+        texture_stream(e);
+    }
+    pthread_mutex_unlock(&loader->mutex);
+}
+
+// Queues the next upload step of the entry, ahead of the others if it was
+// drawn last frame. Must hold the lock.
+static void texture_schedule(Texture_Loader *loader, Texture_Handle handle)
+{
+    Texture_Entry *e = &loader->entries.items[handle];
+
+    size_t bytes;
+    if(e->stage == TEXTURE_STAGE_STREAMING) {
+        texture_stream_step(&e->image, e->streamed_level, &bytes);
+    } else if(e->texture == 0) {
+        texture_stream_step(&e->image, e->image.levels, &bytes);
+    } else {
+        bytes = e->image.size;
+    }
+
+    Upload_Priority priority = e->last_used >= loader->frame
+        ? UPLOAD_PRIORITY_VISIBLE
+        : UPLOAD_PRIORITY_BACKGROUND;
+
+    upload_schedule(loader->uploads, texture_upload_job, loader, handle, bytes, priority);
+    e->scheduled = true;
+}
+
+static void texture_evict(Texture_Loader *loader, Texture_Entry *e)
+{
+    LOG_TRACE("evicting texture `%s` (%zu bytes)", e->file_path, e->bytes);
+    gls_delete_textures(1, &e->texture);
+    e->texture = 0;
+    e->bytes = 0;
+    e->status = TEXTURE_EVICTED;
+    loader->evictions += 1;
+}
+
+static size_t texture_loader_projected(const Texture_Loader *loader)
+{
+    return texture_memory_total() - loader->reclaiming;
+}
+
+// Evicts textures that haven't been drawn for a while, least recently drawn
+// first, until needed more bytes fit under the budget. Must hold the lock.
+static bool texture_loader_make_room(Texture_Loader *loader, size_t needed)
+{
+    while(texture_loader_projected(loader) + needed > loader->budget) {
+        Texture_Entry *victim = NULL;
+        for(size_t i = 0; i < loader->entries.count; ++i) {
+            Texture_Entry *e = &loader->entries.items[i];
+            if(e->status != TEXTURE_READY || e->in_flight) continue;
+            if(loader->frame - e->last_used <= TEXTURE_EVICT_FRAMES) continue;
+            if(victim == NULL || e->last_used < victim->last_used) victim = e;
+        }
+        if(victim == NULL) return false;
+
+        texture_evict(loader, victim);
+    }
+    return true;
+}
+
+// Brings the projected texture memory under budget, least recently drawn
+// first: textures that haven't been drawn for a while are evicted, the rest
+// lose their top mip. Textures drawn last frame only lose mips, largest
+// first, once nothing else is left. Must hold the lock.
+static void texture_loader_enforce_budget(Texture_Loader *loader)
+{
+    if(loader->budget == 0) return;
+
+    while(texture_loader_projected(loader) > loader->budget) {
+        Texture_Entry *victim = NULL;
+        size_t victim_index = 0;
+        for(size_t i = 0; i < loader->entries.count; ++i) {
+            Texture_Entry *e = &loader->entries.items[i];
+            if(e->status != TEXTURE_READY || e->in_flight || e->last_used >= loader->frame) continue;
+
+            bool recent = loader->frame - e->last_used <= TEXTURE_EVICT_FRAMES;
+            if(recent && e->levels <= 1) continue;
+
+            if(victim == NULL || e->last_used < victim->last_used) {
+                victim = e;
+                victim_index = i;
+            }
+        }
+
+        if(victim == NULL) {
+            for(size_t i = 0; i < loader->entries.count; ++i) {
+                Texture_Entry *e = &loader->entries.items[i];
+                if(e->status != TEXTURE_READY || e->in_flight || e->levels <= 1) continue;
+                if(victim == NULL || e->bytes > victim->bytes) {
+                    victim = e;
+                    victim_index = i;
+                }
+            }
+        }
+        if(victim == NULL) break;  // down to a single level each
+
+        if(loader->frame - victim->last_used > TEXTURE_EVICT_FRAMES) {
+            texture_evict(loader, victim);
+        } else {
+            victim->reclaim = texture_format_size(victim->format, victim->width, victim->height);
+            loader->reclaiming += victim->reclaim;
+            loader->mip_drops += 1;
+            texture_queue(loader, victim_index, victim->resident_level + 1);
+        }
+    }
+
+    // Bring back the full chain of one shrunk texture that's still being
+    // drawn, if stale textures can make room for it.
+    for(size_t i = 0; i < loader->entries.count; ++i) {
+        Texture_Entry *e = &loader->entries.items[i];
+        if(e->status != TEXTURE_READY || e->in_flight || e->resident_level == 0) continue;
+        if(e->last_used < loader->frame) continue;
+
+        if(texture_loader_make_room(loader, e->full_bytes - e->bytes)) {
+            loader->reloads += 1;
+            texture_queue(loader, i, 0);
+        }
+        break;
+    }
+}
+
+void texture_loader_update(Texture_Loader *loader)
+{
+    size_t changed = 0;
+
+    pthread_mutex_lock(&loader->mutex);
+    for(size_t i = 0; i < loader->entries.count && loader->pending > 0; ++i) {
+        Texture_Entry *e = &loader->entries.items[i];
+        if(!e->in_flight) continue;
+
+        Texture_Status status = e->status;
+
+        if(e->stage == TEXTURE_STAGE_DECODED) {
+            texture_map(loader, i);
+        } else if(e->stage == TEXTURE_STAGE_COPIED || e->stage == TEXTURE_STAGE_STREAMING) {
+            if(!e->scheduled) texture_schedule(loader, i);
+        }
+
+        if(e->stage == TEXTURE_STAGE_STREAMING) e->status = TEXTURE_READY;
+
+        if(e->stage == TEXTURE_STAGE_DONE || e->stage == TEXTURE_STAGE_FAILED) {
+            if(e->stage == TEXTURE_STAGE_DONE) {
+                e->status = TEXTURE_READY;
+            } else if(e->texture) {
+                // A failed reload leaves the texture as it was.
+                LOG_WARN("failed to reload `%s`, keeping the resident levels", e->file_path);
+            } else {
+                e->status = TEXTURE_FAILED;
+            }
+
+            loader->reclaiming -= e->reclaim;
+            e->reclaim = 0;
+            e->in_flight = false;
+            loader->pending -= 1;
+        }
+
+        if(e->status != status) changed += 1;
+    }
+
+    texture_loader_enforce_budget(loader);
+    pthread_mutex_unlock(&loader->mutex);
+
+    loader->frame += 1;
+
+    texture_loader_deliver(loader);
+
+    if(changed == 0) return;
+
+    // Callbacks run unlocked so they are free to queue more loads.
+    for(size_t i = 0; i < loader->entries.count; ++i) {
+        Texture_Entry *e = &loader->entries.items[i];
+        if(e->status == TEXTURE_PENDING || e->callback == NULL) continue;
+
+        Texture_Callback callback = e->callback;
+        e->callback = NULL;
+        callback(loader, i, e->user_data);
+    }
+}
+
+void texture_loader_set_budget(Texture_Loader *loader, size_t bytes)
+{
+    loader->budget = bytes;
+}
+
+Texture_Status texture_loader_status(const Texture_Loader *loader, Texture_Handle handle)
+{
+    assert(handle < loader->entries.count);
+    return loader->entries.items[handle].status;
+}
+
+GLuint texture_loader_texture(Texture_Loader *loader, Texture_Handle handle)
+{
+    assert(handle < loader->entries.count);
+    Texture_Entry *e = &loader->entries.items[handle];
+
+    // An upload step queued while it wasn't drawn would otherwise wait
+    // behind older background work.
+    if(e->scheduled && e->last_used < loader->frame) {
+        upload_raise(loader->uploads, loader, handle, UPLOAD_PRIORITY_VISIBLE);
+    }
+    e->last_used = loader->frame;
+
+    if(e->status == TEXTURE_EVICTED) {
+        pthread_mutex_lock(&loader->mutex);
+        texture_queue(loader, handle, 0);
+        pthread_mutex_unlock(&loader->mutex);
+
+        e->status = TEXTURE_PENDING;
+        loader->reloads += 1;
+    }
+
+    // Shrunk textures keep being drawn with the levels they have left.
+    return e->texture ? e->texture : loader->placeholder;
+}
+
+Texture_Residency texture_loader_residency(const Texture_Loader *loader, Texture_Handle handle)
+{
+    assert(handle < loader->entries.count);
+    const Texture_Entry *e = &loader->entries.items[handle];
+
+    return (Texture_Residency) {
+        .status = e->status,
+        .bytes = e->bytes,
+        .first_level = e->resident_level,
+        .levels = e->levels,
+        .last_used = e->last_used,
+    };
+}
+
+Texture_Loader_Stats texture_loader_stats(const Texture_Loader *loader)
+{
+    Texture_Loader_Stats stats = {
+        .budget = loader->budget,
+        .total_bytes = texture_memory_total(),
+        .evictions = loader->evictions,
+        .mip_drops = loader->mip_drops,
+        .reloads = loader->reloads,
+    };
+
+    for(size_t i = 0; i < loader->entries.count; ++i) {
+        const Texture_Entry *e = &loader->entries.items[i];
+        stats.loader_bytes += e->bytes;
+        if(e->texture) stats.resident += 1;
+        if(e->status == TEXTURE_EVICTED) stats.evicted += 1;
+    }
+
+    return stats;
+}
@@ -0,0 +1,111 @@
+#ifndef TEXTURE_LOADER_H_
+#define TEXTURE_LOADER_H_
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "texture_cache.h"
+#include "upload_scheduler.h"
+
+/**
+ * Asynchronous Texture Loader
+ *
+ * Images are decoded by a pool of worker threads. The render thread maps a
+ * pixel unpack buffer (PBO) for every decoded image, a worker copies the
+ * pixels into it, and the render thread then starts the upload from the
+ * PBO, which doesn't wait for the transfer. texture_loader_update() drives
+ * all of that and never blocks; call it once per frame. The uploads
+ * themselves go through an upload scheduler, textures drawn last frame
+ * first, so they're issued when that scheduler runs.
+ *
+ * Until a texture is ready texture_loader_texture() returns a shared
+ * placeholder, so it can be drawn with right away. Completion can be polled
+ * with texture_loader_status() or delivered through a callback, which runs
+ * on the render thread from texture_loader_update().
+ *
+ * New textures stream in smallest level first. They turn ready as soon as
+ * their coarse levels are uploaded and sharpen over the next frames as
+ * texture_loader_update() lowers GL_TEXTURE_BASE_LEVEL to each finer level
+ * that arrives, as fast as the scheduler's budget allows.
+ *
+ * With a budget set, texture_loader_update() keeps the engine's texture
+ * memory (see texture_memory.h) under it. Fetching a texture with
+ * texture_loader_texture() counts as drawing it that frame. Textures that
+ * haven't been drawn for a while are evicted, recently drawn ones lose
+ * their top mip levels, least recently drawn first. Evicted textures are
+ * loaded again the next time they're fetched, and shrunk ones get their
+ * levels back once there's room.
+ *
+ * texture_loader_decode() only runs the decode on the workers and hands
+ * the pixels back instead of making a texture of them, for callers that
+ * pack images into textures of their own, like atlas pages.
+ */
+
+typedef size_t Texture_Handle;
+
+typedef enum {
+    TEXTURE_PENDING = 0,
+    TEXTURE_READY,
+    TEXTURE_FAILED,
+    TEXTURE_EVICTED,  // dropped for the budget, comes back when it's fetched
+} Texture_Status;
+
+typedef struct Texture_Loader Texture_Loader;
+
+typedef void (*Texture_Callback)(Texture_Loader *loader, Texture_Handle handle, void *user_data);
+
+// Receives a decoded image, NULL if it failed to load. id tells apart the
+// decodes of a context. The image is freed once the callback returns, unless
+// the callback takes it over and leaves *image zeroed.
+typedef void (*Texture_Decode_Callback)(void *context, size_t id, Texture_Image *image);
+
+typedef struct {
+    Texture_Status status;
+    size_t bytes;           // resident
+    int first_level;        // of the full chain, > 0 once top mips were dropped
+    int levels;             // resident
+    uint64_t last_used;     // frame it was last fetched in
+} Texture_Residency;
+
+typedef struct {
+    size_t budget;          // 0 for none
+    size_t total_bytes;     // of every tracked texture, not only the loader's
+    size_t loader_bytes;
+    size_t resident;
+    size_t evicted;
+    size_t evictions;       // since the loader was created
+    size_t mip_drops;
+    size_t reloads;
+} Texture_Loader_Stats;
+
+// uploads has to outlive the loader.
+Texture_Loader *texture_loader_create(size_t worker_count, Upload_Scheduler *uploads);
+void texture_loader_destroy(Texture_Loader *loader);
+
+// Queues file_path for loading; callback may be NULL.
+Texture_Handle texture_loader_load(Texture_Loader *loader, const char *file_path,
+                                   Texture_Callback callback, void *user_data);
+
+// Queues file_path for decoding only. callback runs on the render thread
+// from a later texture_loader_update(), and never once the loader is destroyed.
+void texture_loader_decode(Texture_Loader *loader, const char *file_path, Texture_Cache_Options options,
+                           Texture_Decode_Callback callback, void *context, size_t id);
+
+// Advances the pipeline and enforces the budget on the render thread
+// without blocking. Call once per frame.
+void texture_loader_update(Texture_Loader *loader);
+
+// Budget for all texture memory in bytes, 0 for none.
+void texture_loader_set_budget(Texture_Loader *loader, size_t bytes);
+
+Texture_Status texture_loader_status(const Texture_Loader *loader, Texture_Handle handle);
+
+// Texture to draw handle with this frame, marking it as used.
+GLuint texture_loader_texture(Texture_Loader *loader, Texture_Handle handle);
+
+Texture_Residency texture_loader_residency(const Texture_Loader *loader, Texture_Handle handle);
+Texture_Loader_Stats texture_loader_stats(const Texture_Loader *loader);
+
+#endif // TEXTURE_LOADER_H_
@@ -0,0 +1,64 @@
+#include "texture_memory.h"
+
+#include "dynamic_array.h"
+
+typedef struct {
+    GLuint texture;
+    size_t bytes;
+} Texture_Memory_Entry;
+
+typedef struct {
+    Texture_Memory_Entry *items;
+    size_t count;
+    size_t capacity;
+    size_t total;
+} Texture_Memory;
+
+static Texture_Memory memory;
+
+static Texture_Memory_Entry *texture_memory_find(GLuint texture)
+{
+    for(size_t i = 0; i < memory.count; ++i) {
+        if(memory.items[i].texture == texture) return &memory.items[i];
+    }
+    return NULL;
+}
+
+void texture_memory_track(GLuint texture, size_t bytes)
+{
+    if(texture == 0) return;
+
+    Texture_Memory_Entry *entry = texture_memory_find(texture);
+    if(entry) {
+        memory.total -= entry->bytes;
+        entry->bytes = bytes;
+    } else {
+        da_append(&memory, ((Texture_Memory_Entry){texture, bytes}));
+    }
+    memory.total += bytes;
+}
+
+void texture_memory_untrack(GLuint texture)
+{
+    Texture_Memory_Entry *entry = texture_memory_find(texture);
+    if(entry == NULL) return;
+
+    memory.total -= entry->bytes;
+    *entry = memory.items[--memory.count];
+}
+
+size_t texture_memory_bytes(GLuint texture)
+{
+    Texture_Memory_Entry *entry = texture_memory_find(texture);
+    return entry ? entry->bytes : 0;
+}
+
+size_t texture_memory_total(void)
+{
+    return memory.total;
+}
+
+size_t texture_memory_count(void)
+{
+    return memory.count;
+}
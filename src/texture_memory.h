@@ -0,0 +1,26 @@
+#ifndef TEXTURE_MEMORY_H_
+#define TEXTURE_MEMORY_H_
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+
+/**
+ * Texture Memory Accounting
+ *
+ * Every GL texture the engine creates is registered here with the bytes its
+ * levels take, so budgets are enforced against everything that's resident,
+ * not only what one module owns. gls_delete_textures() drops deleted
+ * textures. Sizes are those of the uploaded data; the driver's padding and
+ * alignment come on top. Render thread only.
+ */
+
+// Sets the size of texture, replacing what was tracked for it before.
+void texture_memory_track(GLuint texture, size_t bytes);
+void texture_memory_untrack(GLuint texture);
+
+size_t texture_memory_bytes(GLuint texture);
+size_t texture_memory_total(void);
+size_t texture_memory_count(void);
+
+#endif // TEXTURE_MEMORY_H_
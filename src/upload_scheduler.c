@@ -0,0 +1,108 @@
+#include "upload_scheduler.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "dynamic_array.h"
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_jobs(const void *a, const void *b)
+{
+    const Upload_Job *x = a;
+    const Upload_Job *y = b;
+    if(x->priority != y->priority) return x->priority > y->priority ? -1 : 1;
+    if(x->sequence != y->sequence) return x->sequence < y->sequence ? -1 : 1;
+    return 0;
+}
+
+void upload_scheduler_init(Upload_Scheduler *s, size_t frame_bytes, double frame_seconds)
+{
+    *s = (Upload_Scheduler){
+        .frame_bytes = frame_bytes,
+        .frame_seconds = frame_seconds,
+    };
+}
+
+void upload_scheduler_deallocate(Upload_Scheduler *s)
+{
+    free(s->jobs.items);
+    free(s->running.items);
+    *s = (Upload_Scheduler){0};
+}
+
+void upload_schedule(Upload_Scheduler *s, Upload_Fn fn, void *context, size_t id,
+                     size_t bytes, Upload_Priority priority)
+{
+    assert(fn != NULL);
+    assert(priority < UPLOAD_PRIORITY_COUNT);
+
+    Upload_Job job = {fn, context, id, bytes, priority, s->sequence++};
+    da_append(&s->jobs, job);
+}
+
+void upload_cancel(Upload_Scheduler *s, void *context)
+{
+    size_t kept = 0;
+    for(size_t i = 0; i < s->jobs.count; ++i) {
+        if(s->jobs.items[i].context != context) s->jobs.items[kept++] = s->jobs.items[i];
+    }
+    s->jobs.count = kept;
+}
+
+void upload_raise(Upload_Scheduler *s, void *context, size_t id, Upload_Priority priority)
+{
+    assert(priority < UPLOAD_PRIORITY_COUNT);
+
+    for(size_t i = 0; i < s->jobs.count; ++i) {
+        Upload_Job *job = &s->jobs.items[i];
+        if(job->context == context && job->id == id && job->priority < priority) job->priority = priority;
+    }
+}
+
+void upload_scheduler_run(Upload_Scheduler *s)
+{
+    s->stats = (Upload_Stats){0};
+
+    // Jobs scheduled by the ones that run land in jobs again and wait for
+    // the next run, so nothing can keep a run going forever.
+    Upload_Jobs running = s->jobs;
+    s->jobs = s->running;
+    s->jobs.count = 0;
+    s->running = running;
+
+    qsort(running.items, running.count, sizeof(*running.items), compare_jobs);
+
+    double start = now_seconds();
+    size_t i = 0;
+    for(; i < running.count; ++i) {
+        const Upload_Job *job = &running.items[i];
+        if(i > 0) {
+            if(s->frame_bytes > 0 && s->stats.bytes + job->bytes > s->frame_bytes) break;
+            if(s->frame_seconds > 0.0 && s->stats.seconds >= s->frame_seconds) break;
+        }
+
+        job->fn(job->context, job->id);
+        s->stats.uploads += 1;
+        s->stats.bytes += job->bytes;
+        s->stats.seconds = now_seconds() - start;
+    }
+
+    // What didn't fit waits with the newly scheduled jobs. Their sequence
+    // still puts it first within its priority on the next run.
+    size_t left = running.count - i;
+    if(left > 0) da_append_many(&s->jobs, running.items + i, left);
+    s->running.count = 0;
+    s->stats.queued = s->jobs.count;
+}
+
+Upload_Stats upload_scheduler_stats(const Upload_Scheduler *s)
+{
+    return s->stats;
+}
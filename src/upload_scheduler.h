@@ -0,0 +1,85 @@
+#ifndef UPLOAD_SCHEDULER_H_
+#define UPLOAD_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Per-frame Upload Scheduler
+ *
+ * Bulk uploads (texture levels, large buffer updates) are queued here
+ * instead of being issued right away, and upload_scheduler_run() issues
+ * them once per frame within a budget of bytes and of CPU time spent
+ * submitting them. A big asset load then spreads over several frames
+ * instead of stalling one.
+ *
+ * Queued uploads run highest priority first, in the order they were
+ * scheduled within a priority. A queued upload can be raised, so work
+ * queued in the background jumps ahead once it's needed. Every run issues
+ * at least one upload, even one larger than the whole budget, so the queue
+ * always drains. Uploads scheduled while running are left for the next run.
+ *
+ * Only work that may land a few frames late belongs here; data the current
+ * frame draws with is uploaded directly. Render thread only.
+ */
+
+typedef enum {
+    UPLOAD_PRIORITY_BACKGROUND = 0,  // not drawn at the moment
+    UPLOAD_PRIORITY_VISIBLE,         // drawn in the last frame
+    UPLOAD_PRIORITY_COUNT,
+} Upload_Priority;
+
+// Issues the GL calls of one upload. id tells apart the uploads of a context.
+typedef void (*Upload_Fn)(void *context, size_t id);
+
+typedef struct {
+    Upload_Fn fn;
+    void *context;
+    size_t id;
+    size_t bytes;             // charged against the frame budget
+    Upload_Priority priority;
+    uint64_t sequence;        // order it was scheduled in
+} Upload_Job;
+
+typedef struct {
+    Upload_Job *items;
+    size_t count;
+    size_t capacity;
+} Upload_Jobs;
+
+typedef struct {
+    size_t queued;
+    size_t uploads;           // issued by the last run
+    size_t bytes;
+    double seconds;
+} Upload_Stats;
+
+typedef struct {
+    size_t frame_bytes;       // 0 for no limit
+    double frame_seconds;     // 0 for no limit
+    uint64_t sequence;
+
+    Upload_Jobs jobs;
+    Upload_Jobs running;
+    Upload_Stats stats;
+} Upload_Scheduler;
+
+void upload_scheduler_init(Upload_Scheduler *s, size_t frame_bytes, double frame_seconds);
+void upload_scheduler_deallocate(Upload_Scheduler *s);
+
+void upload_schedule(Upload_Scheduler *s, Upload_Fn fn, void *context, size_t id,
+                     size_t bytes, Upload_Priority priority);
+
+// Drops every queued upload of context, for when it goes away before they ran.
+void upload_cancel(Upload_Scheduler *s, void *context);
+
+// Raises queued uploads of context and id to at least priority, for when
+// what they're for becomes visible while they wait.
+void upload_raise(Upload_Scheduler *s, void *context, size_t id, Upload_Priority priority);
+
+// Issues queued uploads until the frame budget is spent. Call once per frame.
+void upload_scheduler_run(Upload_Scheduler *s);
+
+Upload_Stats upload_scheduler_stats(const Upload_Scheduler *s);
+
+#endif // UPLOAD_SCHEDULER_H_